@@ -0,0 +1,198 @@
+// Soak run against the real audio endpoints: millions of mixed operations, failing calls included,
+// while sampling RSS, the native heap, open handles and live native objects. Fails when any of them
+// grew past its threshold between the end of the warmup and the end of the run.
+//
+//   node --expose-gc bench/soak.js [--operations n] [--batch n] [--samples n]
+//                                  [--rss MB] [--heap MB] [--handles n] [--objects n]
+const { setImmediate: yieldToLoop } = require('timers/promises');
+const audio = require('../');
+
+const { VolumeControl, MicrophoneMute, SharedState } = audio;
+
+function option(name, fallback) {
+  const index = process.argv.indexOf(`--${name}`);
+  return index >= 0 && index + 1 < process.argv.length ? Number(process.argv[index + 1]) : fallback;
+}
+
+const settings = {
+  operations: option('operations', 2000000),
+  batch: option('batch', 500),
+  samples: option('samples', 100),
+  rssMB: option('rss', 32),
+  heapMB: option('heap', 16),
+  handles: option('handles', 64),
+  objects: option('objects', 0),
+};
+
+const activeState = 1; // DEVICE_STATE_ACTIVE
+
+function activeEndpoints() {
+  const devices = audio.getDevices();
+  const render = [];
+  const capture = [];
+  for (let i = 0; i < devices.ids.length; i++) {
+    if (devices.states[i] & activeState) {
+      (devices.flows[i] === 0 ? render : capture).push(devices.ids[i]);
+    }
+  }
+  return { render, capture };
+}
+
+// Calls expected to throw, the point is the native error path running
+function expectThrow(call) {
+  try {
+    call();
+  } catch (error) {
+    return;
+  }
+  throw new Error(`Expected a failure: ${call}`);
+}
+
+function pick(list, n) {
+  return list[n % list.length];
+}
+
+// The operations mixed, each takes how many times the whole mix ran so far, which picks its endpoint
+// or session independently of its position in the mix
+function createOperations(endpoints, resident) {
+  const everyEndpoint = endpoints.render.concat(endpoints.capture);
+  let sessions = resident.getSessions();
+  return [
+    // Controller churn across every endpoint, direct and pooled
+    (n) => new VolumeControl(pick(everyEndpoint, n)).dispose(),
+    (n) => {
+      const controller = VolumeControl.open(pick(everyEndpoint, n));
+      VolumeControl.open(pick(everyEndpoint, n)).dispose();
+      controller.dispose();
+    },
+    // Left to the garbage collector instead of disposed
+    (n) => new VolumeControl(pick(everyEndpoint, n)).getVolume(),
+    () => resident.getVolume(),
+    () => resident.setVolume(resident.getVolume()),
+    () => resident.setMuted(resident.isMuted()),
+    () => {
+      sessions = resident.getSessions();
+    },
+    () => resident.getSessionTable(),
+    () => resident.readEvents(64),
+    () => resident.getEventStats(),
+    // Sessions end at any time, so a handle of the latest listing may have expired since
+    (n) => {
+      if (sessions.length > 0) {
+        try {
+          resident.getSessionVolume(pick(sessions, n).handle);
+        } catch (error) {
+          sessions = resident.getSessions();
+        }
+      }
+    },
+    // Failing calls
+    () => expectThrow(() => resident.setVolume(2)),
+    () => expectThrow(() => resident.getSessionVolume(0xfffffff)),
+    () => expectThrow(() => new VolumeControl('{soak}.{no-such-endpoint}')),
+    () => expectThrow(() => new SharedState('{soak}.{no-such-endpoint}')),
+    () => {
+      const disposed = new VolumeControl();
+      disposed.dispose();
+      expectThrow(() => disposed.getVolume());
+    },
+    // Starts and stops a native thread
+    (n) => {
+      if (endpoints.capture.length > 0) {
+        new MicrophoneMute(pick(endpoints.capture, n)).close();
+      }
+    },
+    () => {
+      resident.startPublishing();
+      resident.stopPublishing();
+    },
+  ];
+}
+
+function sample(operations) {
+  if (global.gc) {
+    global.gc();
+  }
+  const native = audio.getNativeStats();
+  const objects = Object.values(native.objects).reduce((sum, count) => sum + count, 0);
+  return {
+    operations,
+    rss: process.memoryUsage().rss,
+    jsHeap: process.memoryUsage().heapUsed,
+    nativeHeap: native.heapAllocated,
+    handles: native.handles,
+    objects,
+    byKind: native.objects,
+  };
+}
+
+const megabyte = 1024 * 1024;
+
+function growth(baseline, last) {
+  const failures = [];
+  const check = (name, grown, limit, unit) => {
+    if (grown > limit) {
+      failures.push(`${name} grew by ${grown.toFixed(1)}${unit}, limit ${limit}${unit}`);
+    }
+  };
+  check('rss', (last.rss - baseline.rss) / megabyte, settings.rssMB, ' MB');
+  if (baseline.nativeHeap >= 0 && last.nativeHeap >= 0) {
+    check('native heap', (last.nativeHeap - baseline.nativeHeap) / megabyte, settings.heapMB, ' MB');
+  }
+  check('handles', last.handles - baseline.handles, settings.handles, '');
+  for (const kind of Object.keys(last.byKind)) {
+    check(`live ${kind}`, last.byKind[kind] - baseline.byKind[kind], settings.objects, '');
+  }
+  return failures;
+}
+
+async function main() {
+  if (!global.gc) {
+    console.error('Run with --expose-gc, samples are noisy without collecting first');
+  }
+  const endpoints = activeEndpoints();
+  if (endpoints.render.length === 0) {
+    console.error('No active render endpoint to soak');
+    process.exit(2);
+  }
+
+  const resident = new VolumeControl();
+  resident.setEventHandler(null);
+  const operations = createOperations(endpoints, resident);
+  const sampleEvery = Math.max(settings.batch, Math.floor(settings.operations / settings.samples));
+  const warmup = Math.min(settings.operations / 10, 10 * sampleEvery);
+
+  console.log('operations,rss,jsHeap,nativeHeap,handles,objects');
+  let baseline = null;
+  let last = null;
+  const start = Date.now();
+  for (let done = 0; done < settings.operations;) {
+    for (let i = 0; i < settings.batch; i++, done++) {
+      operations[done % operations.length](Math.floor(done / operations.length));
+    }
+    // Lets handle close callbacks and finalizers run between batches
+    await yieldToLoop();
+
+    if (done % sampleEvery < settings.batch) {
+      last = sample(done);
+      console.log([last.operations, last.rss, last.jsHeap, last.nativeHeap, last.handles, last.objects].join(','));
+      if (baseline === null && done >= warmup) {
+        baseline = last;
+      }
+    }
+  }
+  resident.dispose();
+
+  const seconds = (Date.now() - start) / 1000;
+  console.error(`${settings.operations} operations in ${seconds.toFixed(0)} s, ${(settings.operations / seconds).toFixed(0)} per s`);
+  const failures = growth(baseline || last, last);
+  for (const failure of failures) {
+    console.error(failure);
+  }
+  process.exit(failures.length > 0 ? 1 : 0);
+}
+
+main().catch((error) => {
+  console.error(error);
+  process.exit(1);
+});
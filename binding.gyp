@@ -1,8 +1,20 @@
 {
+  "variables": {
+    "audio_tracepoints%": 0,
+    "audio_call_stats%": 0,
+    "audio_cached_reads%": 0
+  },
+  "target_defaults": {
+    "conditions": [
+      [ "audio_tracepoints==1", { "defines": [ "AUDIO_TRACEPOINTS" ] } ],
+      [ "audio_call_stats==1", { "defines": [ "AUDIO_CALL_STATS" ] } ],
+      [ "audio_cached_reads==1", { "defines": [ "AUDIO_CACHED_READS" ] } ]
+    ]
+  },
   "targets": [
     {
       "target_name": "volume_controller",
-      "sources": [ "src/volume_controller.cc" ],
+      "sources": [ "src/volume_controller.cc", "src/volume_control.cc" ],
       "libraries": [ "ole32.lib"],
       "include_dirs": [
         "<!(node -e \"require('nan')\")"
@@ -12,6 +24,38 @@
           'AdditionalOptions' : ['/EHsc']
         },
       }
+    },
+    {
+      "target_name": "audiod",
+      "type": "executable",
+      "sources": [ "src/audiod.cc", "src/volume_control.cc" ],
+      "libraries": [ "ole32.lib"],
+      'msvs_settings' : {
+        'VCCLCompilerTool' : {
+          'AdditionalOptions' : ['/EHsc']
+        },
+      }
+    },
+    {
+      "target_name": "audioctl",
+      "type": "executable",
+      "sources": [ "src/audioctl.cc" ],
+      'msvs_settings' : {
+        'VCCLCompilerTool' : {
+          'AdditionalOptions' : ['/EHsc']
+        },
+      }
+    },
+    {
+      "target_name": "audiobench",
+      "type": "executable",
+      "sources": [ "src/audiobench.cc", "src/volume_control.cc" ],
+      "libraries": [ "ole32.lib"],
+      'msvs_settings' : {
+        'VCCLCompilerTool' : {
+          'AdditionalOptions' : ['/EHsc']
+        },
+      }
     }
   ]
 }
\ No newline at end of file
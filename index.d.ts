@@ -1,6 +1,451 @@
+export type AudioSessionState = 'active' | 'inactive' | 'expired';
+
+/** Endpoint id string or a device handle from getDevices() */
+export interface DefaultDeviceOptions {
+    /** Defaults to 'render' */
+    flow?: 'render' | 'capture';
+    /** Defaults to 'console' */
+    role?: 'console' | 'multimedia' | 'communications';
+}
+
+/** An endpoint id, a handle from getDevices() or the current default for a flow and role */
+export type DeviceSelector = string | number | DefaultDeviceOptions;
+
+/** Session instance id string or a session handle from getSessions() */
+export type SessionSelector = string | number;
+
+export interface AudioSession {
+    handle: number;
+    id: string;
+    pid: number;
+    name: string;
+    volume: number;
+    muted: boolean;
+    state: AudioSessionState;
+    systemSounds: boolean;
+}
+
+/** Native session state columns indexed by slot, slots without a session have a zero handle */
+export interface SessionTable {
+    handles: Uint32Array;
+    volumes: Float32Array;
+    muted: Uint8Array;
+    /** 0 inactive, 1 active, 2 expired */
+    states: Uint8Array;
+    /** 1 live, 2 system sounds */
+    flags: Uint8Array;
+}
+
+export interface VolumeHistoryOptions {
+    /** Defaults to the device itself */
+    session?: SessionSelector;
+    /** Unix time in ms, defaults to 24 hours ago */
+    from?: number;
+    /** Unix time in ms, defaults to now */
+    to?: number;
+    /** Defaults to 'minute' */
+    resolution?: 'raw' | 'second' | 'minute';
+}
+
+/** Samples or buckets containing changes, the volume holds its value in between */
+export interface VolumeHistory {
+    times: Float64Array;
+    min: Float32Array;
+    max: Float32Array;
+    last: Float32Array;
+    /** 1 muted at the end, 2 muted at some point */
+    muted: Uint8Array;
+}
+
+export interface MeterOptions {
+    /** Sampling interval in ms, defaults to 50 */
+    interval?: number;
+    /** Samples kept, defaults to 65536 */
+    capacity?: number;
+}
+
+export interface MeterQueryOptions {
+    /** Unix time in ms, defaults to a minute ago */
+    from?: number;
+    /** Unix time in ms, defaults to now */
+    to?: number;
+    /** Window length in ms, defaults to the whole range */
+    window?: number;
+    /** Peak level for timeAbove, defaults to 0.1 (-20 dBFS) */
+    threshold?: number;
+    /** Defaults to 0.95 */
+    percentile?: number;
+}
+
+/** Peak meter aggregates per window, percentile and timeAbove resolve to 1.5 dB */
+export interface MeterWindows {
+    /** Window start, Unix time in ms */
+    times: Float64Array;
+    min: Float32Array;
+    max: Float32Array;
+    avg: Float32Array;
+    percentile: Float32Array;
+    /** ms spent above the threshold */
+    timeAbove: Float64Array;
+    /** Samples in the window, 0 when nothing was recorded */
+    count: Uint32Array;
+}
+
+export interface ExposureOptions {
+    /** File keeping the daily dose across restarts */
+    file?: string;
+    /** dB SPL the output reaches at 0 dBFS with the volume at its maximum, defaults to 100 */
+    referenceLevel?: number;
+    /** Dose fractions raising an 'exposure' event once a day, defaults to [0.5, 1] */
+    thresholds?: number[];
+}
+
+export interface Exposure {
+    /** Today's noise dose, 1 is the daily allowance of 85 dB(A) for 8 hours */
+    dose: number;
+    /** Estimated level of the latest meter sample in dB SPL, -Infinity while silent or muted */
+    level: number;
+}
+
+export interface ExposureEvent {
+    type: 'exposure';
+    time: number;
+    dose: number;
+    threshold: number;
+}
+
+export interface SilenceOptions {
+    /** Peak level at or below which the output counts as silent, defaults to 0.001 (-60 dBFS) */
+    threshold?: number;
+    /** ms the level must stay below the threshold, defaults to 2000 */
+    hold?: number;
+    /** Longest sampling interval in ms while silent, defaults to 1000 */
+    maxInterval?: number;
+}
+
+export interface SilenceEvent {
+    type: 'silenceStart' | 'silenceEnd';
+    time: number;
+    /** When the level fell below the threshold, Unix time in ms */
+    since: number;
+}
+
+export interface VoiceDetectionOptions {
+    /** Mute the microphone natively when speech stops, defaults to false */
+    autoMute?: boolean;
+    /** ms of speech before 'voiceStart', defaults to 60 */
+    attack?: number;
+    /** ms without speech before 'voiceStop', defaults to 400 */
+    release?: number;
+    /** dB above the tracked noise floor, defaults to 9 */
+    margin?: number;
+    /** Spectral flatness below which a frame is tonal enough for speech, defaults to 0.35 */
+    flatness?: number;
+}
+
+export interface VoiceEvent {
+    type: 'voiceStart' | 'voiceStop';
+    time: number;
+    /** End of the audio frame that decided the transition, Unix time in ms */
+    frameTime: number;
+}
+
+export interface VolumeEvent {
+    type: 'volume';
+    time: number;
+    /** Session handle, 0 for the device itself */
+    target: number;
+    volume: number;
+    muted: boolean;
+}
+
+export type LeaseControl = 'volume' | 'mute';
+
+export interface LeaseEvent {
+    type: 'lease';
+    time: number;
+    control: LeaseControl;
+    /** Pid of the new owner, 0 when nobody holds the control */
+    owner: number;
+    isOwner: boolean;
+}
+
+export interface LeaseOptions {
+    /** The highest priority writes, the earliest of equal ones. Defaults to 0 */
+    priority?: number;
+    /** Defaults to both */
+    controls?: LeaseControl[];
+}
+
+export type AudioEvent = ExposureEvent | SilenceEvent | VoiceEvent | VolumeEvent | LeaseEvent;
+
+export interface EventStreamOptions {
+    /** Events held natively while the consumer is behind, defaults to 1024 */
+    capacity?: number;
+    /** Events taken from the native queue per read, defaults to 16 */
+    readSize?: number;
+}
+
+export interface EventStats {
+    queued: number;
+    capacity: number;
+    delivered: number;
+    /** Events dropped because the queue was full, oldest first */
+    dropped: number;
+    /** Volume changes replaced by a newer one of the same target */
+    coalesced: number;
+    /** Smoothed time events waited for the event loop */
+    latencyMs: number;
+    /** Whether waiting events currently go to the batch handler */
+    lagging: boolean;
+}
+
+export interface ProcessNameCacheStats {
+    hits: number;
+    misses: number;
+    evictions: number;
+    size: number;
+}
+
+export interface DeviceList {
+    ids: string[];
+    names: string[];
+    descriptions: string[];
+    jackSubTypes: string[];
+    /** 0 for render, 1 for capture endpoints */
+    flows: Uint8Array;
+    /** DEVICE_STATE_* flags */
+    states: Uint32Array;
+    /** EndpointFormFactor values */
+    formFactors: Uint32Array;
+    /** Stable integers accepted wherever an endpoint id is */
+    handles: Uint32Array;
+}
+
+export interface ControllerStats {
+    /** Native controllers neither disposed nor collected */
+    live: number;
+    /** Controllers held by the pool of VolumeControl.open() */
+    pooled: number;
+}
+
+export interface NativeStats {
+    /** Live native objects by kind: VolumeControl, EndpointVolumeListener, SessionEventsListener, ... */
+    objects: Record<string, number>;
+    /** Open handles of the process */
+    handles: number;
+    /** Bytes allocated from the process heap, -1 when it cannot be summarized */
+    heapAllocated: number;
+}
+
+export interface CallStats {
+    calls: number;
+    /** Calls that threw */
+    failures: number;
+    totalMs: number;
+}
+
+export interface LockStats {
+    acquired: number;
+    /** Acquisitions that had to wait for another thread */
+    contended: number;
+    waitedMs: number;
+}
+
 export class VolumeControl {
+    /** Controls the default render endpoint unless a device is given */
+    constructor(device?: DeviceSelector);
     getVolume(): number;
     setVolume(volume: number): void;
     isMuted(): boolean;
     setMuted(muted: boolean);
-}
\ No newline at end of file
+    getSessions(): AudioSession[];
+    getSessionVolume(session: SessionSelector): number;
+    setSessionVolume(session: SessionSelector, volume: number): void;
+    isSessionMuted(session: SessionSelector): boolean;
+    setSessionMuted(session: SessionSelector, muted: boolean): void;
+    getSessionTable(): SessionTable;
+    /** Returns the number of sessions written */
+    scaleSessionVolumes(factor: number): number;
+    /** Returns the number of sessions written */
+    setSessionsMuted(muted: boolean, except?: SessionSelector): number;
+    /**
+     * Mutes every session except the selected one(s) in one native pass, a string matches a
+     * session id or an executable name such as "POWERPNT.EXE". Returns the number of sessions muted.
+     */
+    focus(session: SessionSelector): number;
+    /** Unmutes what focus() muted, returns the number of sessions restored */
+    unfocus(): number;
+    isFocused(): boolean;
+    /**
+     * Reverts the latest change made through this controller. Slider drags on one control within
+     * half a second count as one change, batch operations are undone as a whole. Returns the number of writes.
+     */
+    undo(): number;
+    redo(): number;
+    canUndo(): boolean;
+    canRedo(): boolean;
+    getVolumeHistory(options?: VolumeHistoryOptions): VolumeHistory;
+    /** Samples the peak meter on a native thread, restarting drops the recorded samples */
+    startMetering(options?: MeterOptions): void;
+    stopMetering(): void;
+    isMetering(): boolean;
+    queryMeter(options?: MeterQueryOptions): MeterWindows;
+    /** Integrates the metered output into a daily noise dose, starting the meter if needed */
+    startExposureTracking(options?: ExposureOptions): void;
+    stopExposureTracking(): void;
+    getExposure(): Exposure;
+    /**
+     * Raises 'silenceStart' and 'silenceEnd' events and backs the meter off while silent, starting
+     * the meter if needed. null turns detection off.
+     */
+    setSilenceDetection(options?: SilenceOptions | null): void;
+    isSilent(): boolean;
+    /**
+     * Runs voice activity detection on the captured signal of a microphone and raises 'voiceStart'
+     * and 'voiceStop' events. Throws for render endpoints.
+     */
+    startVoiceDetection(options?: VoiceDetectionOptions): void;
+    stopVoiceDetection(): void;
+    isSpeaking(): boolean;
+    /**
+     * Receives events raised natively, null removes the handler. While events wait more than about
+     * 20 ms for the event loop, all waiting events go to `batchHandler` in one call instead, packed
+     * as [type code, time, target, value, detail] per event, until the wait drops below about 4 ms.
+     */
+    setEventHandler(handler: ((event: AudioEvent) => void) | null, batchHandler?: (packed: Float64Array) => void): void;
+    /**
+     * Native events as an async iterable. Slow consumers see only the latest volume of each
+     * target. Replaces the event handler, one consumer per controller.
+     */
+    events(options?: EventStreamOptions): AsyncIterableIterator<AudioEvent>;
+    setEventSignal(signal: (() => void) | null): void;
+    readEvents(max?: number): AudioEvent[];
+    setEventCapacity(capacity: number): void;
+    getEventStats(): EventStats;
+    /**
+     * Calls of getVolume, setVolume, isMuted, setMuted, getSessions and the session volume and mute
+     * methods as called from JS, the reads an operation makes internally are not counted. null unless
+     * the addon was built with audio_call_stats=1.
+     */
+    getCallStats(): Record<string, CallStats> | null;
+    /**
+     * Publishes the device and session state to shared memory for other processes, see SharedState.
+     * Volume changes are published as they happen, the sessions as of the latest getSessions().
+     * A later publisher of the same device takes over and this one stops, isPublishing() turns
+     * false. Returns the name of the segment.
+     */
+    startPublishing(): string;
+    stopPublishing(): void;
+    isPublishing(): boolean;
+    /**
+     * Joins the per endpoint lease shared by every process on this machine. Only the owner of a
+     * control may write it, setVolume() and setMuted() throw elsewhere. Owners that exit or crash
+     * hand over at once, ownership changes arrive as 'lease' events.
+     */
+    joinLease(options?: LeaseOptions): void;
+    leaveLease(): void;
+    /** Whether this process may write the control now, always true without a lease */
+    holdsLease(control?: LeaseControl): boolean;
+    /** Pid of the owner, 0 when nobody holds it or this process has not joined */
+    getLeaseOwner(control?: LeaseControl): number;
+    /**
+     * Releases the COM references and stops the native threads now, later calls throw. A pooled
+     * controller is released by the dispose() matching its last open().
+     */
+    dispose(): void;
+    [Symbol.dispose](): void;
+    /**
+     * The pooled controller of the endpoint, shared by everyone opening it, including its event
+     * handler, meter and lease. Every open() needs a dispose().
+     */
+    static open(device?: DeviceSelector): VolumeControl;
+}
+
+export interface MuteResult {
+    muted: boolean;
+    /** ms from the request to the endpoint confirming it */
+    latency: number;
+}
+
+export interface LatencyStats {
+    count: number;
+    min: number;
+    max: number;
+    mean: number;
+    p50: number;
+    p90: number;
+    p99: number;
+    /** Upper bounds in ms of the histogram buckets holding samples */
+    bounds: Float64Array;
+    counts: Float64Array;
+}
+
+/**
+ * Mute fast path for a microphone. The endpoint is activated up front and a native thread issues
+ * the change, promises resolve once the endpoint notification confirms it and reject after a second
+ * without one.
+ */
+export class MicrophoneMute {
+    /** Defaults to the default communications microphone */
+    constructor(device?: DeviceSelector);
+    /** Rejects right away while 1024 earlier requests still wait for their confirmation */
+    setMuted(muted: boolean): Promise<MuteResult>;
+    toggle(): Promise<MuteResult>;
+    /** The state of the latest endpoint notification */
+    isMuted(): boolean;
+    getLatencyStats(): LatencyStats;
+    /** Stops the native thread, requests Windows has not confirmed yet reject */
+    close(): void;
+    [Symbol.dispose](): void;
+}
+
+export interface SharedSession {
+    /** Handle in the publishing process */
+    handle: number;
+    pid: number;
+    volume: number;
+    muted: boolean;
+    state: 'active' | 'inactive' | 'expired';
+    systemSounds: boolean;
+}
+
+export interface SharedStateSnapshot {
+    publisherPid: number;
+    /** Unix time in ms of the latest write */
+    updated: number;
+    volume: number;
+    muted: boolean;
+    sessions: SharedSession[];
+}
+
+/** Read only view of the state another process publishes with startPublishing() */
+export class SharedState {
+    /** Defaults to the default render device, throws when nobody publishes it */
+    constructor(device?: DeviceSelector);
+    /** A consistent copy, null until the publisher has written one */
+    read(): SharedStateSnapshot | null;
+    /** Changes with every write */
+    getVersion(): number;
+    close(): void;
+    [Symbol.dispose](): void;
+}
+
+export function resolveProcessNames(pids: number[]): string[];
+export function getProcessNameCacheStats(): ProcessNameCacheStats;
+export function getControllerStats(): ControllerStats;
+export function getNativeStats(): NativeStats;
+/** Contention of the internal mutexes by the class owning them, e.g. EventQueue or ProcessNameCache */
+export function getLockStats(): Record<string, LockStats>;
+export function getDevices(): DeviceList;
+/**
+ * Privacy mode: mutes every active microphone in one native pass and keeps muting microphones
+ * connected while it is on. Turning it off unmutes exactly what it muted. Returns the number of
+ * endpoints changed.
+ */
+export function setCapturePrivacy(on: boolean): number;
+/** Endpoint id of the current default, kept natively from the default device notifications */
+export function getDefaultDevice(options?: DefaultDeviceOptions): string | null;
+export function isCapturePrivacyOn(): boolean;
+/** Event type names by the type codes of packed events */
+export const eventTypes: readonly string[];
\ No newline at end of file
@@ -1 +1,80 @@
-module.exports = require('./build/Release/volume_controller.node');
+const native = require('./build/Release/volume_controller.node');
+
+const { MicrophoneMute } = native;
+
+// Resolve once the endpoint notification confirms the change
+MicrophoneMute.prototype.setMuted = function (muted) {
+  return new Promise((resolve, reject) => {
+    this.requestMute(!!muted, (error, result) => (error ? reject(error) : resolve(result)));
+  });
+};
+
+MicrophoneMute.prototype.toggle = function () {
+  return new Promise((resolve, reject) => {
+    this.requestMute('toggle', (error, result) => (error ? reject(error) : resolve(result)));
+  });
+};
+
+const { VolumeControl } = native;
+
+// Async iterator over the native event queue. Events are pulled a few at a time, the rest waits
+// natively where volume changes of one target coalesce and the capacity bounds the backlog.
+VolumeControl.prototype.events = function (options = {}) {
+  const controller = this;
+  const readSize = options.readSize || 16;
+  if (options.capacity !== undefined) {
+    controller.setEventCapacity(options.capacity);
+  }
+
+  let buffered = [];
+  let wake = null;
+  let finished = false;
+  controller.setEventSignal(() => {
+    if (wake) {
+      const resolve = wake;
+      wake = null;
+      resolve();
+    }
+  });
+
+  const iterator = {
+    async next() {
+      while (!finished) {
+        if (buffered.length === 0) {
+          buffered = controller.readEvents(readSize);
+        }
+        if (buffered.length > 0) {
+          return { value: buffered.shift(), done: false };
+        }
+        await new Promise((resolve) => {
+          wake = resolve;
+        });
+      }
+      return { value: undefined, done: true };
+    },
+    async return() {
+      if (!finished) {
+        finished = true;
+        controller.setEventSignal(null);
+        if (wake) {
+          wake();
+          wake = null;
+        }
+      }
+      return { value: undefined, done: true };
+    },
+    [Symbol.asyncIterator]() {
+      return iterator;
+    },
+  };
+  return iterator;
+};
+
+// `using` support, disposing releases the native resources right away instead of at the next GC
+if (Symbol.dispose) {
+  VolumeControl.prototype[Symbol.dispose] = VolumeControl.prototype.dispose;
+  MicrophoneMute.prototype[Symbol.dispose] = MicrophoneMute.prototype.close;
+  native.SharedState.prototype[Symbol.dispose] = native.SharedState.prototype.close;
+}
+
+module.exports = native;
@@ -0,0 +1,456 @@
+#include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cwchar>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "lock_stats.h"
+#include "tracepoints.h"
+#include "volume_control.h"
+
+// audiobench [--device <endpoint id>] [--threads 1,2,4,8] [--controllers n] [--ops n] [--op get|set|mute|sessions]
+//            [--core plain,counted,cached,locked|all] [--shared]
+//
+// Scalability matrix: for every controller core and thread count, each thread opens `controllers`
+// controllers of the endpoint on its own and then drives them round robin, `ops` operations per
+// thread. Reports the throughput and latencies of every row with the lock contention it caused, so
+// serialization shows up either as a contended lock or as throughput that stops growing with no
+// lock to blame, i.e. in the audio service. Comparing the cores shows what each policy costs, plain
+// is what the addon runs by default. With --shared all threads drive the same controllers, which
+// takes the locked core.
+
+AUDIO_TRACE_PROVIDER_DEFINITION();
+
+typedef std::chrono::steady_clock Clock;
+
+enum class BenchOp
+{
+  Get,
+  Set,
+  Mute,
+  Sessions,
+};
+
+// The policy combinations of BasicVolumeControl instantiated in volume_control.cc
+enum class BenchCore
+{
+  Plain,
+  Counted,
+  Cached,
+  Locked,
+};
+
+static const char* coreName(BenchCore core)
+{
+  switch (core)
+  {
+    case BenchCore::Plain:
+      return "plain";
+    case BenchCore::Counted:
+      return "counted";
+    case BenchCore::Cached:
+      return "cached";
+    default:
+      return "locked";
+  }
+}
+
+struct Settings
+{
+  std::wstring deviceId;
+  std::vector<unsigned> threads;
+  std::vector<BenchCore> cores;
+  bool shared = false;
+  unsigned controllers = 4;
+  unsigned ops = 20000;
+  BenchOp op = BenchOp::Get;
+};
+
+struct Row
+{
+  double seconds;
+  std::vector<uint32_t> latencies; // us, every operation of every thread
+  unsigned failed;
+};
+
+// Writes the state read up front, so the endpoint ends up as it was
+template <typename Control>
+static void run(Control& control, BenchOp op, float volume, BOOL muted)
+{
+  switch (op)
+  {
+    case BenchOp::Get:
+      control.getVolume();
+      break;
+    case BenchOp::Set:
+      control.setVolume(volume);
+      break;
+    case BenchOp::Mute:
+      control.setMuted(muted);
+      break;
+    case BenchOp::Sessions:
+      control.getSessions();
+      break;
+  }
+}
+
+// None when the endpoint cannot be opened
+template <typename Control>
+static std::vector<std::unique_ptr<Control>> openControls(const Settings& settings)
+{
+  std::vector<std::unique_ptr<Control>> controls;
+  try
+  {
+    for (unsigned c = 0; c < settings.controllers; c++)
+    {
+      controls.emplace_back(new Control(settings.deviceId));
+    }
+  }
+  catch (std::string e)
+  {
+    fprintf(stderr, "%s\n", e.c_str());
+    controls.clear();
+  }
+  return controls;
+}
+
+// Every thread opens its own controllers unless `shared` are given
+template <typename Control>
+static Row runRow(const Settings& settings, unsigned threadCount, const std::vector<std::unique_ptr<Control>>* shared)
+{
+  std::atomic<unsigned> ready(0);
+  std::atomic<bool> go(false);
+  std::atomic<unsigned> failed(0);
+  std::vector<std::vector<uint32_t>> latencies(threadCount);
+  std::vector<std::thread> threads;
+  Clock::time_point start;
+
+  for (unsigned t = 0; t < threadCount; t++)
+  {
+    threads.emplace_back([&, t]() {
+      CoInitializeEx(NULL, COINIT_MULTITHREADED);
+      {
+        std::vector<std::unique_ptr<Control>> owned;
+        if (shared == NULL)
+        {
+          owned = openControls<Control>(settings);
+        }
+        const std::vector<std::unique_ptr<Control>>& controls = shared != NULL ? *shared : owned;
+        float volume = 0;
+        BOOL muted = FALSE;
+        try
+        {
+          if (!controls.empty())
+          {
+            volume = controls[0]->getVolume();
+            muted = controls[0]->isMuted();
+          }
+        }
+        catch (std::string e)
+        {
+          fprintf(stderr, "%s\n", e.c_str());
+        }
+
+        ready++;
+        while (!go.load())
+        {
+          std::this_thread::yield();
+        }
+
+        std::vector<uint32_t>& own = latencies[t];
+        own.reserve(settings.ops);
+        for (unsigned i = 0; i < settings.ops && !controls.empty(); i++)
+        {
+          Clock::time_point before = Clock::now();
+          try
+          {
+            run(*controls[i % controls.size()], settings.op, volume, muted);
+          }
+          catch (std::string)
+          {
+            failed++;
+          }
+          own.push_back(static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - before).count()));
+        }
+      }
+      CoUninitialize();
+    });
+  }
+
+  while (ready.load() < threadCount)
+  {
+    std::this_thread::yield();
+  }
+  start = Clock::now();
+  go = true;
+  for (std::thread& thread : threads)
+  {
+    thread.join();
+  }
+
+  Row row;
+  row.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  row.failed = failed.load();
+  for (std::vector<uint32_t>& own : latencies)
+  {
+    row.latencies.insert(row.latencies.end(), own.begin(), own.end());
+  }
+  std::sort(row.latencies.begin(), row.latencies.end());
+  return row;
+}
+
+static uint32_t percentile(const std::vector<uint32_t>& sorted, double fraction)
+{
+  if (sorted.empty())
+  {
+    return 0;
+  }
+  size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+struct LockSnapshot
+{
+  uint64_t acquired[lockSites];
+  uint64_t contended[lockSites];
+  uint64_t waitedMicros[lockSites];
+};
+
+static LockSnapshot snapshotLocks()
+{
+  LockSnapshot snapshot;
+  for (size_t site = 0; site < lockSites; site++)
+  {
+    LockCounters& counters = lockCounters(static_cast<LockSite>(site));
+    snapshot.acquired[site] = counters.acquired.load();
+    snapshot.contended[site] = counters.contended.load();
+    snapshot.waitedMicros[site] = counters.waitedMicros.load();
+  }
+  return snapshot;
+}
+
+// The locks taken during a row, contended ones first
+static void printLocks(const LockSnapshot& before, const LockSnapshot& after)
+{
+  for (size_t site = 0; site < lockSites; site++)
+  {
+    uint64_t acquired = after.acquired[site] - before.acquired[site];
+    if (acquired == 0)
+    {
+      continue;
+    }
+    uint64_t contended = after.contended[site] - before.contended[site];
+    printf("    %-20s %10llu acquired %6.2f%% contended %9.1f ms waited\n",
+      lockSiteName(static_cast<LockSite>(site)),
+      static_cast<unsigned long long>(acquired),
+      100.0 * contended / acquired,
+      (after.waitedMicros[site] - before.waitedMicros[site]) / 1000.0);
+  }
+}
+
+static std::vector<unsigned> parseList(const wchar_t* text)
+{
+  std::vector<unsigned> values;
+  wchar_t* end = NULL;
+  for (const wchar_t* at = text; *at != L'\0'; at = *end == L',' ? end + 1 : end)
+  {
+    unsigned long value = wcstoul(at, &end, 10);
+    if (end == at)
+    {
+      break;
+    }
+    values.push_back(static_cast<unsigned>(std::max<unsigned long>(1, std::min<unsigned long>(value, 256))));
+  }
+  return values;
+}
+
+// False on an unknown name
+static bool parseCores(const std::wstring& text, std::vector<BenchCore>& cores)
+{
+  const BenchCore all[] = {BenchCore::Plain, BenchCore::Counted, BenchCore::Cached, BenchCore::Locked};
+  cores.clear();
+  size_t at = 0;
+  while (at <= text.size())
+  {
+    size_t end = std::min(text.find(L',', at), text.size());
+    std::wstring name = text.substr(at, end - at);
+    bool known = false;
+    for (BenchCore core : all)
+    {
+      std::string coreText = coreName(core);
+      if (name == L"all" || name == std::wstring(coreText.begin(), coreText.end()))
+      {
+        cores.push_back(core);
+        known = true;
+      }
+    }
+    if (!known)
+    {
+      return false;
+    }
+    at = end + 1;
+  }
+  return true;
+}
+
+static Row runCore(const Settings& settings, BenchCore core, unsigned threads, const std::vector<std::unique_ptr<SharedVolumeControl>>* shared)
+{
+  switch (core)
+  {
+    case BenchCore::Plain:
+      return runRow<PlainVolumeControl>(settings, threads, NULL);
+    case BenchCore::Counted:
+      return runRow<CountedVolumeControl>(settings, threads, NULL);
+    case BenchCore::Cached:
+      return runRow<CachedVolumeControl>(settings, threads, NULL);
+    default:
+      return runRow<SharedVolumeControl>(settings, threads, shared);
+  }
+}
+
+static int usage()
+{
+  fprintf(stderr, "usage: audiobench [--device <endpoint id>] [--threads 1,2,4,8] [--controllers n] [--ops n] [--op get|set|mute|sessions]\n");
+  fprintf(stderr, "                  [--core plain,counted,cached,locked|all] [--shared]\n");
+  return 2;
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+  Settings settings;
+  for (int i = 1; i < argc; i++)
+  {
+    if (wcscmp(argv[i], L"--shared") == 0)
+    {
+      settings.shared = true;
+      continue;
+    }
+    const wchar_t* value = i + 1 < argc ? argv[i + 1] : NULL;
+    if (value == NULL)
+    {
+      return usage();
+    }
+    if (wcscmp(argv[i], L"--device") == 0)
+    {
+      settings.deviceId = value;
+    }
+    else if (wcscmp(argv[i], L"--threads") == 0)
+    {
+      settings.threads = parseList(value);
+    }
+    else if (wcscmp(argv[i], L"--controllers") == 0)
+    {
+      settings.controllers = std::max<unsigned>(1, static_cast<unsigned>(wcstoul(value, NULL, 10)));
+    }
+    else if (wcscmp(argv[i], L"--ops") == 0)
+    {
+      settings.ops = std::max<unsigned>(1, static_cast<unsigned>(wcstoul(value, NULL, 10)));
+    }
+    else if (wcscmp(argv[i], L"--core") == 0)
+    {
+      if (!parseCores(value, settings.cores))
+      {
+        return usage();
+      }
+    }
+    else if (wcscmp(argv[i], L"--op") == 0)
+    {
+      std::wstring op = value;
+      if (op == L"get")
+      {
+        settings.op = BenchOp::Get;
+      }
+      else if (op == L"set")
+      {
+        settings.op = BenchOp::Set;
+      }
+      else if (op == L"mute")
+      {
+        settings.op = BenchOp::Mute;
+      }
+      else if (op == L"sessions")
+      {
+        settings.op = BenchOp::Sessions;
+      }
+      else
+      {
+        return usage();
+      }
+    }
+    else
+    {
+      return usage();
+    }
+    i++;
+  }
+  if (settings.threads.empty())
+  {
+    unsigned cores = std::max<unsigned>(1, std::thread::hardware_concurrency());
+    for (unsigned threads = 1; threads <= cores; threads *= 2)
+    {
+      settings.threads.push_back(threads);
+    }
+  }
+
+  if (settings.shared)
+  {
+    settings.cores.assign(1, BenchCore::Locked);
+  }
+  else if (settings.cores.empty())
+  {
+    settings.cores.push_back(BenchCore::Plain);
+  }
+
+  CoInitializeEx(NULL, COINIT_MULTITHREADED);
+  AUDIO_TRACE_REGISTER();
+  std::vector<std::unique_ptr<SharedVolumeControl>> shared;
+  if (settings.shared)
+  {
+    shared = openControls<SharedVolumeControl>(settings);
+  }
+
+  printf("%-8s %7s %11s %12s %12s %8s %8s %8s\n", "core", "threads", "controllers", "ops/s", "ops/s/thread", "p50 us", "p99 us", "max us");
+  int status = 0;
+  for (BenchCore core : settings.cores)
+  {
+    for (unsigned threads : settings.threads)
+    {
+      LockSnapshot before = snapshotLocks();
+      Row row = runCore(settings, core, threads, settings.shared ? &shared : NULL);
+      LockSnapshot after = snapshotLocks();
+
+      if (row.latencies.empty())
+      {
+        fprintf(stderr, "no controller could be opened\n");
+        status = 1;
+        break;
+      }
+      double throughput = row.latencies.size() / row.seconds;
+      printf("%-8s %7u %11u %12.0f %12.0f %8u %8u %8u\n",
+        coreName(core),
+        threads,
+        settings.controllers,
+        throughput,
+        throughput / threads,
+        percentile(row.latencies, 0.5),
+        percentile(row.latencies, 0.99),
+        row.latencies.back());
+      printLocks(before, after);
+      if (row.failed > 0)
+      {
+        printf("    %u operations failed\n", row.failed);
+        status = 1;
+      }
+    }
+  }
+
+  shared.clear();
+  AUDIO_TRACE_UNREGISTER();
+  CoUninitialize();
+  return status;
+}
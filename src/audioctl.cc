@@ -0,0 +1,249 @@
+#include <windows.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <string>
+#include <vector>
+#include "control_protocol.h"
+#include "latency_histogram.h"
+
+// audioctl [--pipe <name>] <command>
+//
+//   get | set <0..1> | muted | mute | unmute | toggle | ping
+//   bench [requests] [depth] [ping|get]
+//
+// Client of audiod. bench keeps `depth` requests in flight, writing the replacements for every
+// batch of responses in one write, and reports throughput and round trip latencies.
+
+static HANDLE connect(const std::wstring& name)
+{
+  for (int attempt = 0; attempt < 10; attempt++)
+  {
+    HANDLE pipe = CreateFileW(name.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    if (pipe != INVALID_HANDLE_VALUE)
+    {
+      return pipe;
+    }
+    if (GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeW(name.c_str(), 2000))
+    {
+      break;
+    }
+  }
+  return INVALID_HANDLE_VALUE;
+}
+
+static bool writeAll(HANDLE pipe, const void* data, size_t bytes)
+{
+  DWORD written = 0;
+  return WriteFile(pipe, data, static_cast<DWORD>(bytes), &written, NULL) && written == bytes;
+}
+
+// Reads at least one whole response, more if they have arrived
+static bool readResponses(HANDLE pipe, std::vector<char>& buffer, size_t& filled, std::vector<ControlResponse>& responses)
+{
+  responses.clear();
+  while (filled < sizeof(ControlResponse))
+  {
+    DWORD read = 0;
+    if (!ReadFile(pipe, buffer.data() + filled, static_cast<DWORD>(buffer.size() - filled), &read, NULL) || read == 0)
+    {
+      return false;
+    }
+    filled += read;
+  }
+  size_t frames = filled / sizeof(ControlResponse);
+  responses.resize(frames);
+  memcpy(responses.data(), buffer.data(), frames * sizeof(ControlResponse));
+  filled -= frames * sizeof(ControlResponse);
+  memmove(buffer.data(), buffer.data() + frames * sizeof(ControlResponse), filled);
+  return true;
+}
+
+static int runCommand(HANDLE pipe, ControlOp op, float value)
+{
+  ControlRequest request = {1, op, {0, 0, 0}, value};
+  std::vector<char> buffer(sizeof(ControlResponse) * 4);
+  size_t filled = 0;
+  std::vector<ControlResponse> responses;
+  if (!writeAll(pipe, &request, sizeof(request)) || !readResponses(pipe, buffer, filled, responses))
+  {
+    fprintf(stderr, "audiod closed the connection\n");
+    return 1;
+  }
+
+  const ControlResponse& response = responses[0];
+  if (response.status != ControlStatus::Ok)
+  {
+    fprintf(stderr, response.status == ControlStatus::BadRequest ? "bad request\n" : "failed (0x%X)\n", response.result);
+    return 1;
+  }
+  switch (op)
+  {
+    case ControlOp::GetVolume:
+    case ControlOp::SetVolume:
+      printf("%.2f\n", response.value);
+      break;
+    case ControlOp::GetMuted:
+    case ControlOp::SetMuted:
+    case ControlOp::ToggleMuted:
+      printf("%s\n", response.value != 0.0f ? "muted" : "unmuted");
+      break;
+    default:
+      printf("pong\n");
+      break;
+  }
+  return 0;
+}
+
+static int runBench(HANDLE pipe, uint32_t total, uint32_t depth, ControlOp op)
+{
+  typedef std::chrono::steady_clock Clock;
+  std::vector<Clock::time_point> sent(depth);
+  std::vector<ControlRequest> batch;
+  std::vector<ControlResponse> responses;
+  std::vector<char> buffer(sizeof(ControlResponse) * depth);
+  size_t filled = 0;
+  LatencyHistogram latencies;
+  uint32_t issued = 0;
+  uint32_t completed = 0;
+  uint32_t failed = 0;
+  uint64_t writes = 0;
+
+  // In order responses and at most `depth` in flight, so id % depth is free when an id is reused
+  auto send = [&](uint32_t count) {
+    batch.clear();
+    Clock::time_point now = Clock::now();
+    for (uint32_t i = 0; i < count && issued < total; i++, issued++)
+    {
+      sent[issued % depth] = now;
+      batch.push_back(ControlRequest{issued, op, {0, 0, 0}, 0.0f});
+    }
+    writes++;
+    return batch.empty() || writeAll(pipe, batch.data(), batch.size() * sizeof(ControlRequest));
+  };
+
+  Clock::time_point start = Clock::now();
+  bool ok = send(depth);
+  while (ok && completed < total)
+  {
+    ok = readResponses(pipe, buffer, filled, responses);
+    Clock::time_point now = Clock::now();
+    for (const ControlResponse& response : responses)
+    {
+      auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - sent[response.id % depth]);
+      latencies.record(static_cast<uint64_t>(elapsed.count()));
+      failed += response.status != ControlStatus::Ok ? 1 : 0;
+    }
+    completed += static_cast<uint32_t>(responses.size());
+    if (ok && issued < total)
+    {
+      ok = send(static_cast<uint32_t>(responses.size()));
+    }
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  if (!ok)
+  {
+    fprintf(stderr, "audiod closed the connection after %u responses\n", completed);
+    return 1;
+  }
+
+  LatencyHistogram::Snapshot snapshot = latencies.snapshot();
+  printf("%u requests, depth %u: %.0f requests/s, %.1f requests per write\n", total, depth, total / seconds, static_cast<double>(total) / writes);
+  printf("latency us: mean %.1f, p50 %llu, p99 %llu, max %llu\n",
+    snapshot.total ? static_cast<double>(snapshot.sum) / snapshot.total : 0.0,
+    static_cast<unsigned long long>(latencies.percentile(0.5)),
+    static_cast<unsigned long long>(latencies.percentile(0.99)),
+    static_cast<unsigned long long>(snapshot.maximum));
+  if (failed > 0)
+  {
+    printf("%u requests failed\n", failed);
+  }
+  return failed > 0 ? 1 : 0;
+}
+
+static int usage()
+{
+  fprintf(stderr, "usage: audioctl [--pipe <name>] get | set <0..1> | muted | mute | unmute | toggle | ping\n");
+  fprintf(stderr, "       audioctl [--pipe <name>] bench [requests] [depth] [ping|get]\n");
+  return 2;
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+  std::wstring pipeName = controlPipeName;
+  int first = 1;
+  if (argc > 2 && wcscmp(argv[1], L"--pipe") == 0)
+  {
+    pipeName = argv[2];
+    first = 3;
+  }
+  if (first >= argc)
+  {
+    return usage();
+  }
+
+  std::wstring command = argv[first];
+  auto argument = [&](int index) -> const wchar_t* { return first + index < argc ? argv[first + index] : NULL; };
+
+  ControlOp op = ControlOp::Ping;
+  float value = 0.0f;
+  if (command == L"get")
+  {
+    op = ControlOp::GetVolume;
+  }
+  else if (command == L"set" && argument(1))
+  {
+    // A typo such as "40%" must not turn into a volume of 0
+    wchar_t* end = NULL;
+    double parsed = wcstod(argument(1), &end);
+    if (end == argument(1) || *end != L'\0' || !(parsed >= 0.0 && parsed <= 1.0))
+    {
+      fwprintf(stderr, L"set needs a volume between 0 and 1, got %ls\n", argument(1));
+      return 2;
+    }
+    op = ControlOp::SetVolume;
+    value = static_cast<float>(parsed);
+  }
+  else if (command == L"muted")
+  {
+    op = ControlOp::GetMuted;
+  }
+  else if (command == L"mute" || command == L"unmute")
+  {
+    op = ControlOp::SetMuted;
+    value = command == L"mute" ? 1.0f : 0.0f;
+  }
+  else if (command == L"toggle")
+  {
+    op = ControlOp::ToggleMuted;
+  }
+  else if (command != L"ping" && command != L"bench")
+  {
+    return usage();
+  }
+
+  HANDLE pipe = connect(pipeName);
+  if (pipe == INVALID_HANDLE_VALUE)
+  {
+    fwprintf(stderr, L"audiod is not listening on %ls\n", pipeName.c_str());
+    return 1;
+  }
+
+  int status;
+  if (command == L"bench")
+  {
+    uint32_t total = argument(1) ? static_cast<uint32_t>(wcstoul(argument(1), NULL, 10)) : 100000;
+    uint32_t depth = argument(2) ? static_cast<uint32_t>(wcstoul(argument(2), NULL, 10)) : 32;
+    bool get = argument(3) && wcscmp(argument(3), L"get") == 0;
+    status = runBench(pipe, std::max<uint32_t>(1, total), std::min<uint32_t>(std::max<uint32_t>(1, depth), 4096), get ? ControlOp::GetVolume : ControlOp::Ping);
+  }
+  else
+  {
+    status = runCommand(pipe, op, value);
+  }
+  CloseHandle(pipe);
+  return status;
+}
@@ -0,0 +1,181 @@
+#include <windows.h>
+#include <cstdio>
+#include <cstring>
+#include <cwchar>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "control_protocol.h"
+#include "tracepoints.h"
+#include "volume_control.h"
+
+// audiod [--pipe <name>] [--device <endpoint id>]
+//
+// Keeps one VolumeControl open and serves the control protocol on a named pipe, so scripts change
+// the volume with a pipe round trip instead of starting Node. Every client gets its own thread,
+// requests of all clients go through the one controller in arrival order.
+
+AUDIO_TRACE_PROVIDER_DEFINITION();
+
+static std::mutex controlMutex;
+
+static ControlResponse handle(VolumeControl& control, const ControlRequest& request)
+{
+  ControlResponse response = {};
+  response.id = request.id;
+  response.op = request.op;
+  response.status = ControlStatus::Ok;
+
+  std::lock_guard<std::mutex> lock(controlMutex);
+  try
+  {
+    switch (request.op)
+    {
+      case ControlOp::Ping:
+        break;
+      case ControlOp::GetVolume:
+        response.value = control.getVolume();
+        break;
+      case ControlOp::SetVolume:
+        if (!(request.value >= 0.0f && request.value <= 1.0f))
+        {
+          response.status = ControlStatus::BadRequest;
+          break;
+        }
+        control.setVolume(request.value);
+        response.value = request.value;
+        break;
+      case ControlOp::GetMuted:
+        response.value = control.isMuted() ? 1.0f : 0.0f;
+        break;
+      case ControlOp::SetMuted:
+        control.setMuted(request.value != 0.0f);
+        response.value = request.value != 0.0f ? 1.0f : 0.0f;
+        break;
+      case ControlOp::ToggleMuted:
+      {
+        BOOL muted = !control.isMuted();
+        control.setMuted(muted);
+        response.value = muted ? 1.0f : 0.0f;
+        break;
+      }
+      default:
+        response.status = ControlStatus::BadRequest;
+        break;
+    }
+  }
+  catch (HResultError e)
+  {
+    response.status = ControlStatus::Failed;
+    response.result = e.hr;
+    fprintf(stderr, "%s\n", e.c_str());
+  }
+  catch (std::string e)
+  {
+    response.status = ControlStatus::Failed;
+    response.result = E_FAIL;
+    fprintf(stderr, "%s\n", e.c_str());
+  }
+  return response;
+}
+
+// Answers everything a read returned with one write, a frame split across reads waits for its rest
+static void serve(HANDLE pipe, VolumeControl* control)
+{
+  CoInitializeEx(NULL, COINIT_MULTITHREADED);
+  std::vector<char> input(controlMaxBatch * sizeof(ControlRequest));
+  std::vector<ControlResponse> responses;
+  responses.reserve(controlMaxBatch);
+  size_t carried = 0;
+
+  DWORD read = 0;
+  while (ReadFile(pipe, input.data() + carried, static_cast<DWORD>(input.size() - carried), &read, NULL) && read > 0)
+  {
+    size_t available = carried + read;
+    size_t frames = available / sizeof(ControlRequest);
+    responses.clear();
+    for (size_t i = 0; i < frames; i++)
+    {
+      ControlRequest request;
+      memcpy(&request, input.data() + i * sizeof(ControlRequest), sizeof(request));
+      responses.push_back(handle(*control, request));
+    }
+
+    carried = available - frames * sizeof(ControlRequest);
+    memmove(input.data(), input.data() + frames * sizeof(ControlRequest), carried);
+
+    DWORD written = 0;
+    DWORD bytes = static_cast<DWORD>(responses.size() * sizeof(ControlResponse));
+    if (bytes > 0 && (!WriteFile(pipe, responses.data(), bytes, &written, NULL) || written != bytes))
+    {
+      break;
+    }
+  }
+
+  FlushFileBuffers(pipe);
+  DisconnectNamedPipe(pipe);
+  CloseHandle(pipe);
+  CoUninitialize();
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+  std::wstring pipeName = controlPipeName;
+  std::wstring deviceId;
+  for (int i = 1; i < argc; i++)
+  {
+    if (wcscmp(argv[i], L"--pipe") == 0 && i + 1 < argc)
+    {
+      pipeName = argv[++i];
+    }
+    else if (wcscmp(argv[i], L"--device") == 0 && i + 1 < argc)
+    {
+      deviceId = argv[++i];
+    }
+    else
+    {
+      fprintf(stderr, "usage: audiod [--pipe <name>] [--device <endpoint id>]\n");
+      return 2;
+    }
+  }
+
+  CoInitializeEx(NULL, COINIT_MULTITHREADED);
+  AUDIO_TRACE_REGISTER();
+  try
+  {
+    VolumeControl control(deviceId);
+    fwprintf(stderr, L"audiod listening on %ls\n", pipeName.c_str());
+
+    for (;;)
+    {
+      DWORD bufferSize = static_cast<DWORD>(controlMaxBatch * sizeof(ControlResponse) * 16);
+      HANDLE pipe = CreateNamedPipeW(
+        pipeName.c_str(),
+        PIPE_ACCESS_DUPLEX,
+        PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+        PIPE_UNLIMITED_INSTANCES,
+        bufferSize,
+        bufferSize,
+        0,
+        NULL);
+      if (pipe == INVALID_HANDLE_VALUE)
+      {
+        checkErrors(HRESULT_FROM_WIN32(GetLastError()), "creating the control pipe");
+      }
+      if (!ConnectNamedPipe(pipe, NULL) && GetLastError() != ERROR_PIPE_CONNECTED)
+      {
+        CloseHandle(pipe);
+        continue;
+      }
+      std::thread(serve, pipe, &control).detach();
+    }
+  }
+  catch (std::string e)
+  {
+    fprintf(stderr, "%s\n", e.c_str());
+    AUDIO_TRACE_UNREGISTER();
+    CoUninitialize();
+    return 1;
+  }
+}
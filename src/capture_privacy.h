@@ -0,0 +1,221 @@
+#pragma once
+#include <windows.h>
+#include <mmdeviceapi.h>
+#include <endpointvolume.h>
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <wrl/client.h>
+#include "check_errors.h"
+#include "com_worker.h"
+#include "endpoint_notifier.h"
+
+// Privacy mode: mutes every active capture endpoint in one pass and keeps muting microphones that
+// show up while it is on, straight from the endpoint notifications. The endpoint volumes are
+// activated once and pooled on a COM worker, which makes all the calls. Turning it off unmutes
+// exactly the endpoints it muted.
+class CapturePrivacy : public EndpointListener
+{
+public:
+  // Lazily created on the addon thread, released by shutdown() before the notifier goes away
+  static CapturePrivacy& shared()
+  {
+    auto& privacy = holder();
+    if (!privacy)
+    {
+      privacy.reset(new CapturePrivacy(EndpointNotifier::instance()));
+    }
+    return *privacy;
+  }
+
+  static void shutdown()
+  {
+    holder().reset();
+  }
+
+  explicit CapturePrivacy(EndpointNotifier* notifier) : notifier(notifier)
+  {
+    notifier->addListener(this);
+  }
+
+  ~CapturePrivacy()
+  {
+    notifier->removeListener(this);
+    worker.call([this] {
+      pool.clear();
+      enumerator.Reset();
+    });
+  }
+
+  // Returns the number of endpoints it muted. The flag goes up first, so devices arriving during
+  // the pass are muted by their notification.
+  size_t engage()
+  {
+    engaged = true;
+    return worker.call([this] { return muteAll(); });
+  }
+
+  // Returns the number of endpoints it unmuted
+  size_t disengage()
+  {
+    engaged = false;
+    return worker.call([this] { return restoreAll(); });
+  }
+
+  bool isEngaged() const
+  {
+    return engaged;
+  }
+
+  void onDeviceAdded(LPCWSTR deviceId) override
+  {
+    arrived(deviceId);
+  }
+
+  void onDeviceStateChanged(LPCWSTR deviceId, DWORD newState) override
+  {
+    if (newState == DEVICE_STATE_ACTIVE)
+    {
+      arrived(deviceId);
+    }
+  }
+
+private:
+  struct PooledEndpoint
+  {
+    Microsoft::WRL::ComPtr<IAudioEndpointVolume> volume;
+    bool mutedHere = false; // Unmuted before privacy mode muted it
+  };
+
+  EndpointNotifier* notifier;
+  std::atomic<bool> engaged{false};
+
+  // Worker thread only
+  Microsoft::WRL::ComPtr<IMMDeviceEnumerator> enumerator;
+  std::unordered_map<std::wstring, PooledEndpoint> pool;
+
+  ComWorker worker; // Declared last, stops before the pool is destroyed
+
+  static std::unique_ptr<CapturePrivacy>& holder()
+  {
+    static std::unique_ptr<CapturePrivacy> privacy;
+    return privacy;
+  }
+
+  static GUID context()
+  {
+    // Marks our own changes in endpoint notifications
+    static const GUID privacyContext = {0x1f6b2c3d, 0x7e4a, 0x4c59, {0x9a, 0x8b, 0x2d, 0x31, 0x5e, 0x70, 0x64, 0xc2}};
+    return privacyContext;
+  }
+
+  // Runs on a COM worker thread of the notifier, so the work is handed to our own worker
+  void arrived(LPCWSTR deviceId)
+  {
+    if (!engaged)
+    {
+      return;
+    }
+    std::wstring id(deviceId);
+    worker.post([this, id] {
+      if (engaged && prepare())
+      {
+        Microsoft::WRL::ComPtr<IMMDevice> device;
+        if (SUCCEEDED(enumerator->GetDevice(id.c_str(), &device)) && isActiveCapture(device.Get()))
+        {
+          mute(id, device.Get());
+        }
+      }
+    });
+  }
+
+  bool prepare()
+  {
+    return enumerator || SUCCEEDED(CoCreateInstance(__uuidof(MMDeviceEnumerator), NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&enumerator)));
+  }
+
+  static bool isActiveCapture(IMMDevice* device)
+  {
+    Microsoft::WRL::ComPtr<IMMEndpoint> endpoint;
+    EDataFlow flow = eRender;
+    DWORD state = 0;
+    return SUCCEEDED(device->QueryInterface(IID_PPV_ARGS(&endpoint))) && SUCCEEDED(endpoint->GetDataFlow(&flow)) && flow == eCapture &&
+           SUCCEEDED(device->GetState(&state)) && state == DEVICE_STATE_ACTIVE;
+  }
+
+  // Returns whether this call muted the endpoint
+  bool mute(const std::wstring& id, IMMDevice* device)
+  {
+    PooledEndpoint& pooled = pool[id];
+    if (!pooled.volume && FAILED(device->Activate(__uuidof(IAudioEndpointVolume), CLSCTX_INPROC_SERVER, NULL, &pooled.volume)))
+    {
+      pool.erase(id);
+      return false;
+    }
+
+    BOOL muted = FALSE;
+    GUID marker = context();
+    if (SUCCEEDED(pooled.volume->GetMute(&muted)) && !muted && SUCCEEDED(pooled.volume->SetMute(TRUE, &marker)))
+    {
+      pooled.mutedHere = true;
+      return true;
+    }
+    return false;
+  }
+
+  size_t muteAll()
+  {
+    if (!prepare())
+    {
+      throw std::string("Error when trying to get a handle to MMDeviceEnumerator device enumerator");
+    }
+    Microsoft::WRL::ComPtr<IMMDeviceCollection> collection;
+    checkErrors(enumerator->EnumAudioEndpoints(eCapture, DEVICE_STATE_ACTIVE, &collection), "enumerating capture endpoints");
+    UINT count = 0;
+    checkErrors(collection->GetCount(&count), "counting capture endpoints");
+
+    size_t muted = 0;
+    std::unordered_set<std::wstring> active;
+    for (UINT i = 0; i < count; i++)
+    {
+      Microsoft::WRL::ComPtr<IMMDevice> device;
+      LPWSTR rawId = NULL;
+      if (FAILED(collection->Item(i, &device)) || FAILED(device->GetId(&rawId)))
+      {
+        continue; // Unplugged during the pass
+      }
+      std::wstring id(rawId);
+      CoTaskMemFree(rawId);
+      active.insert(id);
+      if (mute(id, device.Get()))
+      {
+        muted++;
+      }
+    }
+
+    // Endpoints gone since the last pass leave the pool, unless we still owe them an unmute
+    for (auto it = pool.begin(); it != pool.end();)
+    {
+      it = active.count(it->first) == 0 && !it->second.mutedHere ? pool.erase(it) : std::next(it);
+    }
+    return muted;
+  }
+
+  size_t restoreAll()
+  {
+    size_t restored = 0;
+    GUID marker = context();
+    for (auto& entry : pool)
+    {
+      if (entry.second.mutedHere && SUCCEEDED(entry.second.volume->SetMute(FALSE, &marker)))
+      {
+        restored++;
+      }
+      entry.second.mutedHere = false;
+    }
+    return restored;
+  }
+};
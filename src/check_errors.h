@@ -0,0 +1,34 @@
+#pragma once
+#include <windows.h>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <utility>
+
+template <typename... Args>
+std::string string_format(std::string format, Args... args)
+{
+  size_t size = std::snprintf(nullptr, 0, format.c_str(), args...) + 1; // Extra space for '\0'
+  std::unique_ptr<char[]> buf(new char[size]);
+  std::snprintf(buf.get(), size, format.c_str(), args...);
+  return std::string(buf.get(), buf.get() + size - 1); // We don't want the '\0' inside
+}
+
+// Failure of a call returning an HRESULT. Caught as std::string by everything printing the
+// message, callers forwarding the code catch it by this type.
+struct HResultError : std::string
+{
+  HResultError(std::string message, HRESULT hr) : std::string(std::move(message)), hr(hr)
+  {
+  }
+
+  HRESULT hr;
+};
+
+inline void checkErrors(HRESULT hr, std::string error_message)
+{
+  if (FAILED(hr))
+  {
+    throw HResultError(string_format("%s (0x%X)", error_message.c_str(), hr), hr);
+  }
+}
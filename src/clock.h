@@ -0,0 +1,38 @@
+#pragma once
+#include <windows.h>
+#include <cstdint>
+
+// Milliseconds since the Unix epoch, the time base of everything handed to JS
+inline uint64_t unixTimeMs()
+{
+  FILETIME now;
+  GetSystemTimeAsFileTime(&now);
+  uint64_t ticks = (static_cast<uint64_t>(now.dwHighDateTime) << 32) | now.dwLowDateTime;
+  return (ticks - 116444736000000000ULL) / 10000; // FILETIME counts 100 ns intervals since 1601
+}
+
+// Milliseconds since the Unix epoch of a performance counter reading in 100 ns units, the way audio
+// clients stamp the packets they capture
+inline uint64_t unixTimeOfCounter(uint64_t counter100ns)
+{
+  LARGE_INTEGER counter;
+  LARGE_INTEGER frequency;
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&frequency);
+  uint64_t ticks = static_cast<uint64_t>(counter.QuadPart);
+  uint64_t perSecond = static_cast<uint64_t>(frequency.QuadPart);
+  uint64_t now100ns = ticks / perSecond * 10000000 + ticks % perSecond * 10000000 / perSecond;
+  uint64_t ageMs = now100ns > counter100ns ? (now100ns - counter100ns) / 10000 : 0;
+  return unixTimeMs() - ageMs;
+}
+
+// Days since the Unix epoch in local time, where daily totals roll over
+inline int64_t localDay(uint64_t timeMs)
+{
+  uint64_t ticks = timeMs * 10000 + 116444736000000000ULL;
+  FILETIME utc = {static_cast<DWORD>(ticks), static_cast<DWORD>(ticks >> 32)};
+  FILETIME local;
+  FileTimeToLocalFileTime(&utc, &local);
+  uint64_t localTicks = (static_cast<uint64_t>(local.dwHighDateTime) << 32) | local.dwLowDateTime;
+  return static_cast<int64_t>((localTicks - 116444736000000000ULL) / 10000 / 86400000);
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <windows.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+// A thread in the multithreaded apartment running tasks in order. COM objects created by its
+// tasks belong to it and must only be used and released from its tasks.
+class ComWorker
+{
+public:
+  ComWorker()
+  {
+    thread = std::thread([this] { run(); });
+  }
+
+  // Tasks already posted still run
+  ~ComWorker()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+  }
+
+  ComWorker(const ComWorker&) = delete;
+  ComWorker& operator=(const ComWorker&) = delete;
+
+  void post(std::function<void()> task)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.push_back(std::move(task));
+    wake.notify_one();
+  }
+
+  // Runs `task` on the worker and waits for its result, exceptions are rethrown to the caller
+  template <typename Task>
+  auto call(Task task) -> decltype(task())
+  {
+    std::packaged_task<decltype(task())()> packaged(std::move(task));
+    auto result = packaged.get_future();
+    post([&packaged] { packaged(); });
+    return result.get();
+  }
+
+private:
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::deque<std::function<void()>> tasks;
+  bool stopping = false;
+
+  void run()
+  {
+    CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+      wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+      if (tasks.empty())
+      {
+        break;
+      }
+      std::function<void()> task = std::move(tasks.front());
+      tasks.pop_front();
+      lock.unlock();
+      task();
+      lock.lock();
+    }
+    lock.unlock();
+    CoUninitialize();
+  }
+};
@@ -0,0 +1,243 @@
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include "lock_stats.h"
+
+// Policies of BasicVolumeControl. Each kind comes as an empty variant the compiler removes
+// entirely and one doing the work, so a build only pays for the variants it picks.
+
+// The endpoint and session calls seen by the instrumentation policy
+enum class ControlCall
+{
+  GetVolume,
+  SetVolume,
+  IsMuted,
+  SetMuted,
+  GetSessions,
+  GetSessionVolume,
+  SetSessionVolume,
+  IsSessionMuted,
+  SetSessionMuted,
+};
+
+static const size_t controlCalls = 9;
+
+inline const char* controlCallName(ControlCall call)
+{
+  switch (call)
+  {
+    case ControlCall::GetVolume:
+      return "getVolume";
+    case ControlCall::SetVolume:
+      return "setVolume";
+    case ControlCall::IsMuted:
+      return "isMuted";
+    case ControlCall::SetMuted:
+      return "setMuted";
+    case ControlCall::GetSessions:
+      return "getSessions";
+    case ControlCall::GetSessionVolume:
+      return "getSessionVolume";
+    case ControlCall::SetSessionVolume:
+      return "setSessionVolume";
+    case ControlCall::IsSessionMuted:
+      return "isSessionMuted";
+    default:
+      return "setSessionMuted";
+  }
+}
+
+struct CallStats
+{
+  uint64_t calls[controlCalls];
+  uint64_t failures[controlCalls]; // Calls that threw
+  uint64_t micros[controlCalls];
+};
+
+// Instrumentation: a Scope lives for the duration of every ControlCall
+
+struct NoInstrumentation
+{
+  static const bool enabled = false;
+
+  struct Scope
+  {
+    Scope(NoInstrumentation&, ControlCall)
+    {
+    }
+  };
+
+  CallStats stats() const
+  {
+    return CallStats();
+  }
+};
+
+// Counts calls, failed calls and the time spent in them per ControlCall
+class CallCounters
+{
+public:
+  static const bool enabled = true;
+
+  class Scope
+  {
+  public:
+    Scope(CallCounters& counters, ControlCall call)
+      : counters(counters), call(static_cast<size_t>(call)), exceptions(std::uncaught_exceptions()), start(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~Scope()
+    {
+      auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+      counters.calls[call].fetch_add(1, std::memory_order_relaxed);
+      counters.micros[call].fetch_add(static_cast<uint64_t>(elapsed.count()), std::memory_order_relaxed);
+      if (std::uncaught_exceptions() > exceptions)
+      {
+        counters.failures[call].fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    CallCounters& counters;
+    size_t call;
+    int exceptions;
+    std::chrono::steady_clock::time_point start;
+  };
+
+  CallStats stats() const
+  {
+    CallStats result;
+    for (size_t call = 0; call < controlCalls; call++)
+    {
+      result.calls[call] = calls[call].load(std::memory_order_relaxed);
+      result.failures[call] = failures[call].load(std::memory_order_relaxed);
+      result.micros[call] = micros[call].load(std::memory_order_relaxed);
+    }
+    return result;
+  }
+
+private:
+  std::atomic<uint64_t> calls[controlCalls] = {};
+  std::atomic<uint64_t> failures[controlCalls] = {};
+  std::atomic<uint64_t> micros[controlCalls] = {};
+};
+
+// Locking: a Guard lives for the duration of every operation
+
+// For controllers used by one thread at a time, such as the JS thread
+struct NoLocking
+{
+  struct Guard
+  {
+    explicit Guard(NoLocking&)
+    {
+    }
+  };
+};
+
+// For controllers shared by threads, counted under LockSite::VolumeControl. Recursive as
+// operations call each other, e.g. focus() ends the previous focus through unfocus().
+class MutexLocking
+{
+public:
+  class Guard
+  {
+  public:
+    explicit Guard(MutexLocking& locking) : lock(locking.mutex)
+    {
+    }
+
+  private:
+    std::lock_guard<CountedRecursiveMutex> lock;
+  };
+
+private:
+  CountedRecursiveMutex mutex{LockSite::VolumeControl};
+};
+
+// Cache: where reads of the endpoint volume and mute come from. `volume()` and `muted()` return
+// false when the endpoint has to be asked, `fill*()` keeps what it answered unless something newer
+// arrived meanwhile, `store*()` records writes and notifications.
+
+struct UncachedEndpoint
+{
+  bool volume(float&) const
+  {
+    return false;
+  }
+
+  bool muted(BOOL&) const
+  {
+    return false;
+  }
+
+  void fillVolume(float)
+  {
+  }
+
+  void fillMuted(BOOL)
+  {
+  }
+
+  void storeVolume(float)
+  {
+  }
+
+  void storeMuted(BOOL)
+  {
+  }
+};
+
+// Answers from the latest value written through the controller or notified by the endpoint, so a
+// read skips the COM call. Changes made by other applications show once their notification arrived.
+class NotifiedEndpointCache
+{
+public:
+  bool volume(float& value) const
+  {
+    value = cachedVolume.load(std::memory_order_acquire);
+    return value >= 0.0f;
+  }
+
+  bool muted(BOOL& value) const
+  {
+    int state = cachedMuted.load(std::memory_order_acquire);
+    value = state > 0 ? TRUE : FALSE;
+    return state >= 0;
+  }
+
+  void fillVolume(float value)
+  {
+    float unknown = -1.0f;
+    cachedVolume.compare_exchange_strong(unknown, value);
+  }
+
+  void fillMuted(BOOL value)
+  {
+    int unknown = -1;
+    cachedMuted.compare_exchange_strong(unknown, value ? 1 : 0);
+  }
+
+  void storeVolume(float value)
+  {
+    cachedVolume.store(value, std::memory_order_release);
+  }
+
+  void storeMuted(BOOL value)
+  {
+    cachedMuted.store(value ? 1 : 0, std::memory_order_release);
+  }
+
+private:
+  std::atomic<float> cachedVolume{-1.0f}; // Negative while unknown
+  std::atomic<int> cachedMuted{-1};
+};
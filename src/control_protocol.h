@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Wire format between audiod and its clients: fixed size little endian frames over a byte stream,
+// so either side can write many frames at once and parse whatever a read returned. Clients may
+// send further requests before the responses to earlier ones arrive. The daemon answers in order
+// and writes the responses to everything one read contained in a single write.
+static const wchar_t controlPipeName[] = L"\\\\.\\pipe\\node-audio-windows";
+
+// Frames per read, bounding how many responses go into one write
+static const size_t controlMaxBatch = 256;
+
+enum class ControlOp : uint8_t
+{
+  Ping,
+  GetVolume,
+  SetVolume, // value: 0..1
+  GetMuted,
+  SetMuted, // value: 0 or 1
+  ToggleMuted,
+};
+
+enum class ControlStatus : uint8_t
+{
+  Ok,
+  Failed,     // result holds the HRESULT, 0x80040201 when another process holds the lease of the control
+  BadRequest, // Unknown op or value out of range
+};
+
+#pragma pack(push, 1)
+struct ControlRequest
+{
+  uint32_t id; // Echoed in the response
+  ControlOp op;
+  uint8_t reserved[3];
+  float value;
+};
+
+struct ControlResponse
+{
+  uint32_t id;
+  ControlOp op;
+  ControlStatus status;
+  uint8_t reserved[2];
+  float value; // Volume or mute state after the request
+  int32_t result;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(ControlRequest) == 12, "Requests are 12 bytes on the wire");
+static_assert(sizeof(ControlResponse) == 16, "Responses are 16 bytes on the wire");
@@ -0,0 +1,105 @@
+#pragma once
+#include <windows.h>
+#include <mmdeviceapi.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <wrl/client.h>
+#include "check_errors.h"
+#include "endpoint_notifier.h"
+#include "lock_stats.h"
+
+// The default endpoint of every flow and role, read once and then kept current by
+// OnDefaultDeviceChanged, so looking up e.g. the default communications microphone is a memory read.
+class DefaultDeviceCache : public EndpointListener
+{
+public:
+  // Lazily created on the addon thread, released by shutdown() before the notifier goes away
+  static DefaultDeviceCache& shared()
+  {
+    auto& cache = holder();
+    if (!cache)
+    {
+      cache.reset(new DefaultDeviceCache(EndpointNotifier::instance()));
+    }
+    return *cache;
+  }
+
+  static void shutdown()
+  {
+    holder().reset();
+  }
+
+  explicit DefaultDeviceCache(EndpointNotifier* notifier) : notifier(notifier)
+  {
+    // Listening first, a change arriving during the reads below wins over what they return
+    notifier->addListener(this);
+    for (EDataFlow flow : {eRender, eCapture})
+    {
+      for (ERole role : {eConsole, eMultimedia, eCommunications})
+      {
+        Microsoft::WRL::ComPtr<IMMDevice> device;
+        LPWSTR id = NULL;
+        std::wstring current;
+        if (SUCCEEDED(notifier->deviceEnumerator()->GetDefaultAudioEndpoint(flow, role, &device)) && SUCCEEDED(device->GetId(&id)))
+        {
+          current = id;
+          CoTaskMemFree(id);
+        }
+
+        std::lock_guard<CountedMutex> lock(mutex);
+        Slot& slot = slots[flow][role];
+        if (!slot.known)
+        {
+          slot.id = current;
+          slot.known = true;
+        }
+      }
+    }
+  }
+
+  ~DefaultDeviceCache()
+  {
+    notifier->removeListener(this);
+  }
+
+  // Empty when no endpoint of that flow is present
+  std::wstring defaultId(EDataFlow flow, ERole role)
+  {
+    if ((flow != eRender && flow != eCapture) || role < eConsole || role > eCommunications)
+    {
+      throw std::string("The flow must be render or capture and the role console, multimedia or communications.");
+    }
+    std::lock_guard<CountedMutex> lock(mutex);
+    return slots[flow][role].id;
+  }
+
+  void onDefaultDeviceChanged(EDataFlow flow, ERole role, LPCWSTR deviceId) override
+  {
+    if ((flow != eRender && flow != eCapture) || role < eConsole || role > eCommunications)
+    {
+      return;
+    }
+    std::lock_guard<CountedMutex> lock(mutex);
+    Slot& slot = slots[flow][role];
+    slot.id = deviceId != NULL ? deviceId : L"";
+    slot.known = true;
+  }
+
+private:
+  struct Slot
+  {
+    std::wstring id;
+    bool known = false;
+  };
+
+  EndpointNotifier* notifier;
+  CountedMutex mutex{LockSite::DefaultDeviceCache};
+  Slot slots[2][3]; // [eRender, eCapture][eConsole, eMultimedia, eCommunications]
+
+  static std::unique_ptr<DefaultDeviceCache>& holder()
+  {
+    static std::unique_ptr<DefaultDeviceCache> cache;
+    return cache;
+  }
+};
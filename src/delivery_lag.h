@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+
+// Smoothed time events wait in a queue before the loop thread picks them up. Delivery counts as
+// lagging once the average passes `enterMicros` and stays so until it falls below `exitMicros`,
+// so a loop hovering around one threshold does not flip between modes on every wake up.
+class DeliveryLag
+{
+public:
+  struct Settings
+  {
+    uint64_t enterMicros = 20000;
+    uint64_t exitMicros = 4000;
+    double smoothing = 0.25; // Weight of the newest sample
+  };
+
+  explicit DeliveryLag(const Settings& settings) : settings(settings)
+  {
+  }
+
+  void record(uint64_t waitedMicros)
+  {
+    average = known ? average + (waitedMicros - average) * settings.smoothing : static_cast<double>(waitedMicros);
+    known = true;
+    if (!lagging && average > settings.enterMicros)
+    {
+      lagging = true;
+    }
+    else if (lagging && average < settings.exitMicros)
+    {
+      lagging = false;
+    }
+  }
+
+  bool isLagging() const
+  {
+    return lagging;
+  }
+
+  double averageMicros() const
+  {
+    return average;
+  }
+
+private:
+  Settings settings;
+  double average = 0.0;
+  bool known = false;
+  bool lagging = false;
+};
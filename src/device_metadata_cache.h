@@ -0,0 +1,279 @@
+#pragma once
+#include <windows.h>
+#include <mmdeviceapi.h>
+#include <functiondiscoverykeys_devpkey.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <wrl/client.h>
+#include "check_errors.h"
+#include "endpoint_notifier.h"
+#include "handle_table.h"
+#include "lock_stats.h"
+
+struct DeviceMetadata
+{
+  std::wstring id;
+  std::wstring name;        // PKEY_Device_FriendlyName, e.g. "Speakers (Realtek High Definition Audio)"
+  std::wstring description; // PKEY_Device_DeviceDesc, e.g. "Speakers"
+  std::wstring jackSubType; // PKEY_AudioEndpoint_JackSubType, KSNODETYPE_* GUID of the jack
+  EDataFlow flow;
+  DWORD state;              // DEVICE_STATE_* flags
+  UINT formFactor;          // EndpointFormFactor
+  uint32_t handle;          // Stable integer standing in for the id, see HandleTable
+};
+
+// Keeps the property store values of every endpoint. A snapshot only touches COM when an
+// endpoint notification invalidated something: a changed property re-reads that endpoint's
+// store alone, while added, removed or state-changed devices re-enumerate the endpoint list.
+class DeviceMetadataCache : public EndpointListener
+{
+public:
+  // Lazily created on the addon thread, released by shutdown() before the notifier goes away
+  static DeviceMetadataCache& shared()
+  {
+    auto& cache = holder();
+    if (!cache)
+    {
+      cache.reset(new DeviceMetadataCache(EndpointNotifier::instance()));
+    }
+    return *cache;
+  }
+
+  static void shutdown()
+  {
+    holder().reset();
+  }
+
+  explicit DeviceMetadataCache(EndpointNotifier* notifier)
+    : notifier(notifier), enumerator(notifier->deviceEnumerator())
+  {
+    notifier->addListener(this);
+  }
+
+  ~DeviceMetadataCache()
+  {
+    notifier->removeListener(this);
+  }
+
+  // All active, disabled and unplugged endpoints, must be called from the addon thread
+  std::vector<DeviceMetadata> snapshot()
+  {
+    std::unordered_set<std::wstring> staleIds;
+    {
+      std::lock_guard<CountedMutex> lock(mutex);
+      if (!listChanged && stale.empty())
+      {
+        return devices;
+      }
+      listChanged = false;
+      staleIds.swap(stale);
+    }
+
+    // The COM reads run unlocked so notifications never wait on them. Anything invalidated
+    // meanwhile sets the flags again and is picked up by the next snapshot.
+    std::vector<DeviceMetadata> refreshed;
+    try
+    {
+      refreshed = read(staleIds);
+    }
+    catch (...)
+    {
+      // Properties invalidated before the failed read still have to be read again
+      std::lock_guard<CountedMutex> lock(mutex);
+      listChanged = true;
+      stale.insert(staleIds.begin(), staleIds.end());
+      throw;
+    }
+
+    std::lock_guard<CountedMutex> lock(mutex);
+    std::unordered_set<uint32_t> present;
+    for (DeviceMetadata& device : refreshed)
+    {
+      device.handle = handles.acquire(device.id);
+      present.insert(device.handle);
+    }
+    handles.retain([&](uint32_t handle, NoHandleData&) { return present.count(handle) != 0; });
+
+    devices = refreshed;
+    return refreshed;
+  }
+
+  // Endpoint id behind a handle returned by snapshot()
+  std::wstring idOf(uint32_t handle)
+  {
+    std::lock_guard<CountedMutex> lock(mutex);
+    const std::wstring* id = handles.keyOf(handle);
+    if (!id)
+    {
+      throw string_format("Unknown or removed device handle %u", handle);
+    }
+    return *id;
+  }
+
+  void onDeviceStateChanged(LPCWSTR deviceId, DWORD newState) override
+  {
+    invalidateList();
+  }
+
+  void onDeviceAdded(LPCWSTR deviceId) override
+  {
+    invalidateList();
+  }
+
+  void onDeviceRemoved(LPCWSTR deviceId) override
+  {
+    invalidateList();
+  }
+
+  void onPropertyValueChanged(LPCWSTR deviceId, const PROPERTYKEY key) override
+  {
+    if (!isCachedKey(key))
+    {
+      return;
+    }
+    std::lock_guard<CountedMutex> lock(mutex);
+    stale.insert(deviceId);
+  }
+
+private:
+  EndpointNotifier* notifier;
+  IMMDeviceEnumerator* enumerator;
+  CountedMutex mutex{LockSite::DeviceMetadataCache};
+  std::vector<DeviceMetadata> devices;
+  std::unordered_set<std::wstring> stale;
+  HandleTable<> handles;
+  bool listChanged = true;
+
+  static std::unique_ptr<DeviceMetadataCache>& holder()
+  {
+    static std::unique_ptr<DeviceMetadataCache> cache;
+    return cache;
+  }
+
+  void invalidateList()
+  {
+    std::lock_guard<CountedMutex> lock(mutex);
+    listChanged = true;
+  }
+
+  static bool isCachedKey(const PROPERTYKEY& key)
+  {
+    const PROPERTYKEY* cached[] = {
+      &PKEY_Device_FriendlyName,
+      &PKEY_Device_DeviceDesc,
+      &PKEY_AudioEndpoint_FormFactor,
+      &PKEY_AudioEndpoint_JackSubType,
+    };
+    for (auto candidate : cached)
+    {
+      if (candidate->fmtid == key.fmtid && candidate->pid == key.pid)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  std::vector<DeviceMetadata> read(const std::unordered_set<std::wstring>& staleIds)
+  {
+    std::vector<DeviceMetadata> previous;
+    {
+      std::lock_guard<CountedMutex> lock(mutex);
+      previous = devices;
+    }
+    std::unordered_map<std::wstring, size_t> previousIndex;
+    for (size_t i = 0; i < previous.size(); i++)
+    {
+      previousIndex[previous[i].id] = i;
+    }
+
+    Microsoft::WRL::ComPtr<IMMDeviceCollection> collection;
+    checkErrors(
+      enumerator->EnumAudioEndpoints(
+        eAll,                                                                 // Both render and capture endpoints
+        DEVICE_STATE_ACTIVE | DEVICE_STATE_DISABLED | DEVICE_STATE_UNPLUGGED, // Everything except the long list of removed devices
+        &collection),
+      "enumerating audio endpoints");
+
+    UINT count = 0;
+    checkErrors(collection->GetCount(&count), "counting audio endpoints");
+
+    std::vector<DeviceMetadata> result;
+    result.reserve(count);
+    for (UINT i = 0; i < count; i++)
+    {
+      Microsoft::WRL::ComPtr<IMMDevice> device;
+      checkErrors(collection->Item(i, &device), "getting audio endpoint");
+
+      LPWSTR rawId = NULL;
+      checkErrors(device->GetId(&rawId), "getting audio endpoint id");
+      std::wstring id(rawId);
+      CoTaskMemFree(rawId);
+
+      DWORD state = 0;
+      checkErrors(device->GetState(&state), "getting audio endpoint state");
+
+      auto found = previousIndex.find(id);
+      if (found != previousIndex.end() && staleIds.count(id) == 0)
+      {
+        result.push_back(previous[found->second]);
+        result.back().state = state;
+        continue;
+      }
+
+      DeviceMetadata metadata;
+      metadata.id = id;
+      metadata.handle = HandleTable<>::invalidHandle;
+      metadata.state = state;
+      metadata.flow = eRender;
+
+      Microsoft::WRL::ComPtr<IMMEndpoint> endpoint;
+      if (SUCCEEDED(device.As(&endpoint)))
+      {
+        endpoint->GetDataFlow(&metadata.flow);
+      }
+
+      // One store open per endpoint, all keys read from it while it is held
+      Microsoft::WRL::ComPtr<IPropertyStore> store;
+      checkErrors(device->OpenPropertyStore(STGM_READ, &store), "opening audio endpoint properties");
+      metadata.name = readString(store.Get(), PKEY_Device_FriendlyName);
+      metadata.description = readString(store.Get(), PKEY_Device_DeviceDesc);
+      metadata.jackSubType = readString(store.Get(), PKEY_AudioEndpoint_JackSubType);
+      metadata.formFactor = readUInt(store.Get(), PKEY_AudioEndpoint_FormFactor, UnknownFormFactor);
+
+      result.push_back(metadata);
+    }
+
+    return result;
+  }
+
+  static std::wstring readString(IPropertyStore* store, const PROPERTYKEY& key)
+  {
+    PROPVARIANT value;
+    PropVariantInit(&value);
+    std::wstring result;
+    if (SUCCEEDED(store->GetValue(key, &value)) && value.vt == VT_LPWSTR && value.pwszVal != NULL)
+    {
+      result = value.pwszVal;
+    }
+    PropVariantClear(&value);
+    return result;
+  }
+
+  static UINT readUInt(IPropertyStore* store, const PROPERTYKEY& key, UINT fallback)
+  {
+    PROPVARIANT value;
+    PropVariantInit(&value);
+    UINT result = fallback;
+    if (SUCCEEDED(store->GetValue(key, &value)) && value.vt == VT_UI4)
+    {
+      result = value.ulVal;
+    }
+    PropVariantClear(&value);
+    return result;
+  }
+};
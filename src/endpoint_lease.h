@@ -0,0 +1,205 @@
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include "check_errors.h"
+#include "clock.h"
+#include "event_queue.h"
+#include "lease_table.h"
+#include "object_counts.h"
+#include "process_liveness.h"
+
+// Failure of a device write refused because another process holds the lease of the control
+static const HRESULT leaseConflict = MAKE_HRESULT(SEVERITY_ERROR, FACILITY_ITF, 0x0201);
+
+// This process's membership in the lease table of an endpoint, for the controls in `controls`, a
+// bit per LeaseControl. A thread watches the owners and raises a LeaseChanged event whenever one
+// changes. It waits on the owning process, so a crashed owner hands over at once, and rescans every
+// `scanMs` for holders that left or joined.
+class EndpointLease
+{
+public:
+  static const DWORD scanMs = 25;
+
+  EndpointLease(const std::wstring& endpointId, uint32_t controls, uint16_t priority, std::shared_ptr<EventQueue> events)
+    : controls(controls), priority(priority), events(std::move(events))
+  {
+    for (size_t control = 0; control < leaseControlCount; control++)
+    {
+      slots[control] = -1;
+      tickets[control] = 0;
+      owners[control] = 0;
+    }
+
+    std::wstring name = L"Local\\node-audio-windows.lease." + endpointId;
+    mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(LeaseTable), name.c_str());
+    if (mapping != NULL)
+    {
+      table = static_cast<LeaseTable*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(LeaseTable)));
+    }
+    if (table == NULL)
+    {
+      HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+      close();
+      checkErrors(hr, "opening the lease table");
+    }
+
+    for (size_t control = 0; control < leaseControlCount; control++)
+    {
+      if ((controls & (1u << control)) && !join(static_cast<LeaseControl>(control)))
+      {
+        close();
+        throw std::string("Too many processes share the lease of this endpoint.");
+      }
+    }
+
+    stopEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    thread = std::thread(&EndpointLease::watch, this);
+  }
+
+  ~EndpointLease()
+  {
+    SetEvent(stopEvent);
+    thread.join();
+    CloseHandle(stopEvent);
+    close();
+  }
+
+  EndpointLease(const EndpointLease&) = delete;
+  EndpointLease& operator=(const EndpointLease&) = delete;
+
+  // Checked against the table on every call, so a holder outranking this process counts at once.
+  // Controls this process did not join are never held.
+  bool holds(LeaseControl control)
+  {
+    LeaseTable::Holder holder;
+    return currentOwner(control, holder) && isOwn(control, holder);
+  }
+
+  // Pid of the owner, 0 when nobody holds the control
+  uint32_t owner(LeaseControl control)
+  {
+    LeaseTable::Holder holder;
+    return currentOwner(control, holder) ? holder.pid : 0;
+  }
+
+private:
+  uint32_t controls;
+  uint16_t priority;
+  std::shared_ptr<EventQueue> events;
+  HANDLE mapping = NULL;
+  LeaseTable* table = NULL;
+  std::atomic<int> slots[leaseControlCount];
+  std::atomic<uint64_t> tickets[leaseControlCount]; // Of the joins in `slots`, rewritten by the watcher
+  uint32_t owners[leaseControlCount]; // As last reported, only touched by the watcher
+  HANDLE stopEvent = NULL;
+  std::thread thread;
+  ObjectCount<NativeObject::EndpointLease> counted;
+
+  bool join(LeaseControl control)
+  {
+    size_t index = static_cast<size_t>(control);
+    int slot = table->join(control, GetCurrentProcessId(), processCreated(GetCurrentProcess()), priority, isProcessAlive);
+    if (slot >= 0)
+    {
+      tickets[index] = table->slots[index][slot].ticket.load();
+    }
+    slots[index] = slot;
+    return slot >= 0;
+  }
+
+  bool currentOwner(LeaseControl control, LeaseTable::Holder& holder)
+  {
+    return table->owner(control, slots[static_cast<size_t>(control)], holder, isProcessAlive);
+  }
+
+  // The slot alone is not enough: once this join was evicted by mistake, another process may
+  // have taken the slot before the watcher rejoins
+  bool isOwn(LeaseControl control, const LeaseTable::Holder& holder)
+  {
+    size_t index = static_cast<size_t>(control);
+    int slot = slots[index];
+    return slot >= 0 && holder.slot == slot && holder.ticket == tickets[index].load();
+  }
+
+  void watch()
+  {
+    for (;;)
+    {
+      HANDLE ownerProcess = NULL;
+      for (size_t control = 0; control < leaseControlCount; control++)
+      {
+        if (!(controls & (1u << control)))
+        {
+          continue;
+        }
+        LeaseControl kind = static_cast<LeaseControl>(control);
+        rejoinIfEvicted(kind);
+
+        LeaseTable::Holder holder;
+        uint32_t pid = currentOwner(kind, holder) ? holder.pid : 0;
+        if (pid != owners[control])
+        {
+          owners[control] = pid;
+          bool own = pid != 0 && isOwn(kind, holder);
+          events->push(AudioEvent{AudioEventType::LeaseChanged, unixTimeMs(), static_cast<uint32_t>(control), static_cast<double>(pid), own ? 1.0 : 0.0});
+        }
+        if (ownerProcess == NULL && pid != 0 && pid != GetCurrentProcessId())
+        {
+          ownerProcess = OpenProcess(SYNCHRONIZE, FALSE, pid);
+        }
+      }
+
+      HANDLE waits[] = {stopEvent, ownerProcess};
+      DWORD woken = WaitForMultipleObjects(ownerProcess != NULL ? 2 : 1, waits, FALSE, scanMs);
+      if (ownerProcess != NULL)
+      {
+        CloseHandle(ownerProcess);
+      }
+      if (woken == WAIT_OBJECT_0 || woken == WAIT_FAILED)
+      {
+        return;
+      }
+    }
+  }
+
+  // Another process may wrongly evict this one, e.g. while it was suspended long enough to look dead
+  void rejoinIfEvicted(LeaseControl control)
+  {
+    size_t index = static_cast<size_t>(control);
+    int slot = slots[index];
+    if (slot < 0)
+    {
+      return;
+    }
+    LeaseSlot& entry = table->slots[index][slot];
+    if (entry.priority.load() == 0 || entry.ticket.load() != tickets[index])
+    {
+      join(control);
+    }
+  }
+
+  void close()
+  {
+    if (table != NULL)
+    {
+      for (size_t control = 0; control < leaseControlCount; control++)
+      {
+        if (slots[control] >= 0)
+        {
+          table->leave(static_cast<LeaseControl>(control), slots[control]);
+          slots[control] = -1;
+        }
+      }
+      UnmapViewOfFile(table);
+      table = NULL;
+    }
+    if (mapping != NULL)
+    {
+      CloseHandle(mapping);
+      mapping = NULL;
+    }
+  }
+};
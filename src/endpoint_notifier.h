@@ -0,0 +1,172 @@
+#pragma once
+#include <windows.h>
+#include <mmdeviceapi.h>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+#include <wrl/client.h>
+#include "check_errors.h"
+#include "lock_stats.h"
+
+// Receives the endpoint changes forwarded by EndpointNotifier. The calls arrive on a COM worker
+// thread, so implementations must return quickly and must not add or remove listeners themselves.
+class EndpointListener
+{
+public:
+  virtual ~EndpointListener() {}
+  virtual void onDeviceStateChanged(LPCWSTR deviceId, DWORD newState) {}
+  virtual void onDeviceAdded(LPCWSTR deviceId) {}
+  virtual void onDeviceRemoved(LPCWSTR deviceId) {}
+  virtual void onDefaultDeviceChanged(EDataFlow flow, ERole role, LPCWSTR deviceId) {}
+  virtual void onPropertyValueChanged(LPCWSTR deviceId, const PROPERTYKEY key) {}
+};
+
+// The one IMMNotificationClient registration of the process. Native caches subscribe to it
+// instead of registering their own client, so each endpoint change is delivered once.
+class EndpointNotifier : public IMMNotificationClient
+{
+public:
+  // Lazily creates and registers the notifier, must be called from the addon thread
+  static EndpointNotifier* instance()
+  {
+    auto& notifier = holder();
+    if (!notifier)
+    {
+      Microsoft::WRL::ComPtr<EndpointNotifier> created;
+      created.Attach(new EndpointNotifier());
+      checkErrors(
+        created->enumerator->RegisterEndpointNotificationCallback(created.Get()),
+        "registering for endpoint notifications");
+      notifier = created;
+    }
+    return notifier.Get();
+  }
+
+  // Unregisters the notifier, called when the addon is unloaded
+  static void shutdown()
+  {
+    auto& notifier = holder();
+    if (notifier)
+    {
+      notifier->enumerator->UnregisterEndpointNotificationCallback(notifier.Get());
+      notifier.Reset();
+    }
+  }
+
+  IMMDeviceEnumerator* deviceEnumerator()
+  {
+    return enumerator.Get();
+  }
+
+  void addListener(EndpointListener* listener)
+  {
+    std::lock_guard<CountedMutex> lock(mutex);
+    listeners.push_back(listener);
+  }
+
+  void removeListener(EndpointListener* listener)
+  {
+    std::lock_guard<CountedMutex> lock(mutex);
+    listeners.erase(std::remove(listeners.begin(), listeners.end(), listener), listeners.end());
+  }
+
+  // IUnknown
+
+  ULONG STDMETHODCALLTYPE AddRef() override
+  {
+    return InterlockedIncrement(&references);
+  }
+
+  ULONG STDMETHODCALLTYPE Release() override
+  {
+    ULONG remaining = InterlockedDecrement(&references);
+    if (remaining == 0)
+    {
+      delete this;
+    }
+    return remaining;
+  }
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override
+  {
+    if (riid == __uuidof(IUnknown) || riid == __uuidof(IMMNotificationClient))
+    {
+      *object = static_cast<IMMNotificationClient*>(this);
+      AddRef();
+      return S_OK;
+    }
+    *object = NULL;
+    return E_NOINTERFACE;
+  }
+
+  // IMMNotificationClient
+
+  HRESULT STDMETHODCALLTYPE OnDeviceStateChanged(LPCWSTR deviceId, DWORD newState) override
+  {
+    std::lock_guard<CountedMutex> lock(mutex);
+    for (auto listener : listeners)
+    {
+      listener->onDeviceStateChanged(deviceId, newState);
+    }
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE OnDeviceAdded(LPCWSTR deviceId) override
+  {
+    std::lock_guard<CountedMutex> lock(mutex);
+    for (auto listener : listeners)
+    {
+      listener->onDeviceAdded(deviceId);
+    }
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE OnDeviceRemoved(LPCWSTR deviceId) override
+  {
+    std::lock_guard<CountedMutex> lock(mutex);
+    for (auto listener : listeners)
+    {
+      listener->onDeviceRemoved(deviceId);
+    }
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE OnDefaultDeviceChanged(EDataFlow flow, ERole role, LPCWSTR deviceId) override
+  {
+    std::lock_guard<CountedMutex> lock(mutex);
+    for (auto listener : listeners)
+    {
+      listener->onDefaultDeviceChanged(flow, role, deviceId);
+    }
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE OnPropertyValueChanged(LPCWSTR deviceId, const PROPERTYKEY key) override
+  {
+    std::lock_guard<CountedMutex> lock(mutex);
+    for (auto listener : listeners)
+    {
+      listener->onPropertyValueChanged(deviceId, key);
+    }
+    return S_OK;
+  }
+
+private:
+  LONG references = 1;
+  CountedMutex mutex{LockSite::EndpointNotifier};
+  std::vector<EndpointListener*> listeners;
+  Microsoft::WRL::ComPtr<IMMDeviceEnumerator> enumerator;
+
+  EndpointNotifier()
+  {
+    checkErrors(
+      CoCreateInstance(__uuidof(MMDeviceEnumerator), NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&enumerator)),
+      "Error when trying to get a handle to MMDeviceEnumerator device enumerator");
+  }
+
+  static Microsoft::WRL::ComPtr<EndpointNotifier>& holder()
+  {
+    static Microsoft::WRL::ComPtr<EndpointNotifier> notifier;
+    return notifier;
+  }
+};
@@ -0,0 +1,204 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "delivery_lag.h"
+#include "lock_stats.h"
+#include "tracepoints.h"
+
+enum class AudioEventType : uint8_t
+{
+  ExposureThreshold,
+  SilenceStarted,
+  SilenceEnded,
+  VoiceStarted,
+  VoiceStopped,
+  MuteConfirmed,
+  MuteFailed,
+  VolumeChanged,
+  LeaseChanged,
+};
+
+// A notification raised on a native thread for JS. The meaning of `value` and `detail` depends on
+// the type, e.g. the dose and the threshold it crossed, or when a stretch of silence began.
+struct AudioEvent
+{
+  AudioEventType type;
+  uint64_t time;   // Unix time in ms
+  uint32_t target; // Session handle, 0 for the device itself
+  double value;
+  double detail;
+};
+
+// Hands events from native threads to the JS thread. At most `capacity` events are held: a volume
+// change replaces the one of the same target still waiting, so a slow consumer only sees the
+// latest value, and when the queue is full the oldest event is dropped. `wake` is called on every
+// push, under the lock, so clearing it guarantees no further calls once setWake() returns. Every
+// drain records how long its oldest event waited, which tells whether the consumer is lagging.
+class EventQueue
+{
+public:
+  struct Stats
+  {
+    size_t queued;
+    size_t capacity;
+    uint64_t delivered;
+    uint64_t dropped;
+    uint64_t coalesced;
+    double latencyMs; // Smoothed wait of the oldest event per drain
+    bool lagging;
+  };
+
+  explicit EventQueue(size_t capacity = 1024) : capacity(capacity), lag(DeliveryLag::Settings())
+  {
+  }
+
+  void push(const AudioEvent& event)
+  {
+    std::lock_guard<CountedMutex> lock(mutex);
+    if (coalesces(event))
+    {
+      auto waiting = latest.find(keyOf(event));
+      if (waiting != latest.end())
+      {
+        events[static_cast<size_t>(waiting->second - firstSequence)] = event;
+        coalesced++;
+        AUDIO_TRACE_ENQUEUE(event.type, event.target, events.size(), true);
+        wakeUp();
+        return;
+      }
+    }
+
+    if (events.size() >= capacity)
+    {
+      popFront();
+      dropped++;
+    }
+    if (coalesces(event))
+    {
+      latest[keyOf(event)] = firstSequence + events.size();
+    }
+    events.push_back(event);
+    queuedAt.push_back(nowMicros());
+    AUDIO_TRACE_ENQUEUE(event.type, event.target, events.size(), false);
+    wakeUp();
+  }
+
+  // The oldest `max` events
+  std::vector<AudioEvent> drain(size_t max = SIZE_MAX)
+  {
+    std::lock_guard<CountedMutex> lock(mutex);
+    std::vector<AudioEvent> drained;
+    drained.reserve(std::min(max, events.size()));
+    if (!events.empty() && max > 0)
+    {
+      uint64_t now = nowMicros();
+      lag.record(now > queuedAt.front() ? now - queuedAt.front() : 0);
+    }
+    while (!events.empty() && drained.size() < max)
+    {
+      drained.push_back(events.front());
+      popFront();
+    }
+    delivered += drained.size();
+    AUDIO_TRACE_DEQUEUE(drained.size(), events.size());
+    return drained;
+  }
+
+  // Whether events have waited long enough lately that the consumer should take them in batches
+  bool isLagging() const
+  {
+    std::lock_guard<CountedMutex> lock(mutex);
+    return lag.isLagging();
+  }
+
+  // Events pushed while nothing listens are kept up to the capacity, clearing the wake drops them
+  void setWake(std::function<void()> callback)
+  {
+    std::lock_guard<CountedMutex> lock(mutex);
+    wake = std::move(callback);
+    if (!wake)
+    {
+      events.clear();
+      queuedAt.clear();
+      latest.clear();
+      firstSequence = 0;
+    }
+  }
+
+  void setCapacity(size_t value)
+  {
+    std::lock_guard<CountedMutex> lock(mutex);
+    capacity = std::max<size_t>(1, value);
+    while (events.size() > capacity)
+    {
+      popFront();
+      dropped++;
+    }
+  }
+
+  Stats stats() const
+  {
+    std::lock_guard<CountedMutex> lock(mutex);
+    return Stats{events.size(), capacity, delivered, dropped, coalesced, lag.averageMicros() / 1000.0, lag.isLagging()};
+  }
+
+private:
+  mutable CountedMutex mutex{LockSite::EventQueue};
+  std::deque<AudioEvent> events;
+  std::deque<uint64_t> queuedAt; // Steady time in us each event was queued, kept when it coalesces
+  std::unordered_map<uint64_t, uint64_t> latest; // Coalescing key to the sequence number of its event
+  uint64_t firstSequence = 0;                    // Sequence number of events.front()
+  size_t capacity;
+  std::function<void()> wake;
+  uint64_t delivered = 0;
+  uint64_t dropped = 0;
+  uint64_t coalesced = 0;
+  DeliveryLag lag;
+
+  static uint64_t nowMicros()
+  {
+    auto elapsed = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+  }
+
+  static bool coalesces(const AudioEvent& event)
+  {
+    return event.type == AudioEventType::VolumeChanged;
+  }
+
+  static uint64_t keyOf(const AudioEvent& event)
+  {
+    return (static_cast<uint64_t>(event.type) << 32) | event.target;
+  }
+
+  void popFront()
+  {
+    const AudioEvent& front = events.front();
+    if (coalesces(front))
+    {
+      auto waiting = latest.find(keyOf(front));
+      if (waiting != latest.end() && waiting->second == firstSequence)
+      {
+        latest.erase(waiting);
+      }
+    }
+    events.pop_front();
+    queuedAt.pop_front();
+    firstSequence++;
+  }
+
+  void wakeUp()
+  {
+    if (wake)
+    {
+      wake();
+    }
+  }
+};
@@ -0,0 +1,126 @@
+#pragma once
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Daily exposure state, laid out to be kept in a mapped file
+struct ExposureRecord
+{
+  static const uint32_t currentMagic = 0x45584431; // "EXD1"
+
+  uint32_t magic;
+  uint32_t crossed; // Bit per threshold already reported for `day`
+  int64_t day;      // Local days since the Unix epoch
+  double dose;      // 1.0 is the full daily allowance
+};
+
+// Integrates the estimated sound level at the listener into a daily noise dose, following the
+// NIOSH recommendation: 85 dB(A) for 8 hours is a full dose and every 3 dB above halves the time
+// allowed. The level is estimated from the peak meter, the endpoint gain and the level the output
+// reaches at full scale, so it is an upper bound rather than a measurement.
+class ExposureDose
+{
+public:
+  struct Settings
+  {
+    double referenceLevel = 100.0; // dB SPL at 0 dBFS with the endpoint at its maximum volume
+    double criterionLevel = 85.0;
+    double exchangeRate = 3.0;
+    double criterionHours = 8.0;
+    std::vector<double> thresholds = {0.5, 1.0}; // Dose fractions raising an event, at most 32
+  };
+
+  // `record` is the persisted state, reset when it does not hold a valid record. The dose shares
+  // its ownership, so a mapped record stays mapped while a sampling thread still adds to it.
+  ExposureDose(const Settings& settings, std::shared_ptr<ExposureRecord> record)
+    : settings(settings), record(record ? std::move(record) : std::make_shared<ExposureRecord>())
+  {
+    if (this->record->magic != ExposureRecord::currentMagic || !std::isfinite(this->record->dose) || this->record->dose < 0)
+    {
+      *this->record = ExposureRecord{ExposureRecord::currentMagic, 0, 0, 0.0};
+    }
+    if (this->settings.thresholds.size() > 32)
+    {
+      this->settings.thresholds.resize(32);
+    }
+  }
+
+  ExposureDose(const ExposureDose&) = delete;
+  ExposureDose& operator=(const ExposureDose&) = delete;
+
+  // Endpoint volume in dB below its maximum
+  void setGain(float gainDb, bool muted)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->gainDb = gainDb;
+    this->muted = muted;
+  }
+
+  // Adds one meter sample held for `elapsedMs`, returns a bit per threshold it crossed
+  uint32_t add(int64_t day, float peak, double elapsedMs)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    rollOver(day);
+    if (muted || peak <= 0.0f)
+    {
+      lastLevel = -INFINITY;
+      return 0;
+    }
+
+    lastLevel = settings.referenceLevel + 20.0 * std::log10(peak) + gainDb;
+    double allowedMs = settings.criterionHours * 3600000.0 / std::pow(2.0, (lastLevel - settings.criterionLevel) / settings.exchangeRate);
+    record->dose += elapsedMs / allowedMs;
+
+    uint32_t crossed = 0;
+    for (size_t i = 0; i < settings.thresholds.size(); i++)
+    {
+      uint32_t bit = 1u << i;
+      if ((record->crossed & bit) == 0 && record->dose >= settings.thresholds[i])
+      {
+        crossed |= bit;
+      }
+    }
+    record->crossed |= crossed;
+    return crossed;
+  }
+
+  double dose(int64_t day)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    rollOver(day);
+    return record->dose;
+  }
+
+  // Estimated level of the latest sample in dB SPL, -Infinity while silent or muted
+  double level() const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lastLevel;
+  }
+
+  double threshold(size_t index) const
+  {
+    return settings.thresholds[index];
+  }
+
+private:
+  Settings settings;
+  std::shared_ptr<ExposureRecord> record;
+  mutable std::mutex mutex;
+  float gainDb = 0.0f;
+  bool muted = false;
+  double lastLevel = -INFINITY;
+
+  void rollOver(int64_t day)
+  {
+    if (record->day != day)
+    {
+      record->day = day;
+      record->dose = 0.0;
+      record->crossed = 0;
+    }
+  }
+};
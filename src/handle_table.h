@@ -0,0 +1,186 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct NoHandleData
+{
+};
+
+// Maps string keys (endpoint ids, session instance ids) to small integer handles so hot calls
+// from JS can pass a plain number instead of a long id. A handle packs a slot index with the
+// slot's generation, which is bumped whenever the slot is released, so a stale handle to a
+// reused slot is rejected instead of reaching the new occupant.
+//
+// Handles stay below 2^31 so V8 keeps them as small integers. Not thread-safe.
+template <typename T = NoHandleData>
+class HandleTable
+{
+public:
+  typedef uint32_t Handle;
+
+  static const Handle invalidHandle = 0;
+  static const int indexBits = 20;
+  static const uint32_t indexMask = (1u << indexBits) - 1;
+  static const uint32_t maxGeneration = (1u << (31 - indexBits)) - 1;
+
+  // Returns the handle of `key`, allocating a slot for unknown keys. `created` tells the caller
+  // when the slot value still needs to be initialised.
+  Handle acquire(const std::wstring& key, bool* created = nullptr)
+  {
+    auto found = byKey.find(key);
+    if (found != byKey.end())
+    {
+      if (created)
+      {
+        *created = false;
+      }
+      return found->second;
+    }
+
+    uint32_t index;
+    if (!freeSlots.empty())
+    {
+      index = freeSlots.back();
+      freeSlots.pop_back();
+    }
+    else
+    {
+      index = static_cast<uint32_t>(slots.size());
+      slots.emplace_back();
+    }
+
+    Slot& slot = slots[index];
+    slot.key = key;
+    slot.used = true;
+    slot.value = T();
+
+    Handle handle = makeHandle(index, slot.generation);
+    byKey[key] = handle;
+    if (created)
+    {
+      *created = true;
+    }
+    return handle;
+  }
+
+  Handle find(const std::wstring& key) const
+  {
+    auto found = byKey.find(key);
+    return found == byKey.end() ? invalidHandle : found->second;
+  }
+
+  bool contains(Handle handle) const
+  {
+    return slotOf(handle) != nullptr;
+  }
+
+  // Slot value of a live handle, null for stale or unknown handles
+  T* get(Handle handle)
+  {
+    Slot* slot = slotOf(handle);
+    return slot ? &slot->value : nullptr;
+  }
+
+  const std::wstring* keyOf(Handle handle) const
+  {
+    const Slot* slot = slotOf(handle);
+    return slot ? &slot->key : nullptr;
+  }
+
+  void release(Handle handle)
+  {
+    Slot* slot = slotOf(handle);
+    if (!slot)
+    {
+      return;
+    }
+
+    byKey.erase(slot->key);
+    slot->key.clear();
+    slot->value = T();
+    slot->used = false;
+    slot->generation = slot->generation == maxGeneration ? 1 : slot->generation + 1;
+    freeSlots.push_back(indexOf(handle));
+  }
+
+  // Releases every handle for which `keep(handle, value)` returns false
+  template <typename Predicate>
+  void retain(Predicate keep)
+  {
+    for (uint32_t index = 0; index < slots.size(); index++)
+    {
+      Slot& slot = slots[index];
+      Handle handle = makeHandle(index, slot.generation);
+      if (slot.used && !keep(handle, slot.value))
+      {
+        release(handle);
+      }
+    }
+  }
+
+  // Calls `visit(handle, value)` for every live handle, in slot order
+  template <typename Visitor>
+  void forEach(Visitor visit)
+  {
+    for (uint32_t index = 0; index < slots.size(); index++)
+    {
+      Slot& slot = slots[index];
+      if (slot.used)
+      {
+        visit(makeHandle(index, slot.generation), slot.value);
+      }
+    }
+  }
+
+  size_t size() const
+  {
+    return byKey.size();
+  }
+
+  // Upper bound of indexOf() over live handles, for tables laid out by slot
+  size_t capacity() const
+  {
+    return slots.size();
+  }
+
+  static uint32_t indexOf(Handle handle)
+  {
+    return handle & indexMask;
+  }
+
+private:
+  struct Slot
+  {
+    std::wstring key;
+    uint32_t generation = 1;
+    bool used = false;
+    T value;
+  };
+
+  std::vector<Slot> slots;
+  std::vector<uint32_t> freeSlots;
+  std::unordered_map<std::wstring, Handle> byKey;
+
+  static Handle makeHandle(uint32_t index, uint32_t generation)
+  {
+    return (generation << indexBits) | index;
+  }
+
+  Slot* slotOf(Handle handle)
+  {
+    return const_cast<Slot*>(static_cast<const HandleTable*>(this)->slotOf(handle));
+  }
+
+  const Slot* slotOf(Handle handle) const
+  {
+    uint32_t index = indexOf(handle);
+    if (index >= slots.size())
+    {
+      return nullptr;
+    }
+    const Slot& slot = slots[index];
+    return slot.used && makeHandle(index, slot.generation) == handle ? &slot : nullptr;
+  }
+};
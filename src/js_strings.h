@@ -0,0 +1,205 @@
+#pragma once
+#include <nan.h>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "utf16_transcoder.h"
+
+// Listings sharing the interner, each ages the strings by its own refreshes
+enum class InternPool : uint8_t
+{
+  Sessions, // Session ids and process names
+  Devices,  // Endpoint ids and properties
+};
+
+static const size_t internPools = 2;
+
+// JS strings for values that repeat across refreshes, such as endpoint ids. A string is dropped
+// once no pool handed it out during its last `maxAge` sweeps, which bounds the table to roughly
+// the ids currently in use without session listings evicting device strings.
+class JsStringInterner
+{
+public:
+  static JsStringInterner& shared()
+  {
+    auto& interner = holder();
+    if (!interner)
+    {
+      interner.reset(new JsStringInterner());
+    }
+    return *interner;
+  }
+
+  // Releases the persistent handles, called before the isolate goes away
+  static void shutdown()
+  {
+    holder().reset();
+  }
+
+  bool find(const std::wstring& key, InternPool pool, v8::Local<v8::String>& value)
+  {
+    auto found = entries.find(key);
+    if (found == entries.end())
+    {
+      return false;
+    }
+    use(found->second, pool);
+    value = Nan::New(found->second.value);
+    return true;
+  }
+
+  void store(const std::wstring& key, InternPool pool, v8::Local<v8::String> value)
+  {
+    Entry& entry = entries[key];
+    entry.value.Reset(value);
+    use(entry, pool);
+  }
+
+  // Called once per enumeration result of `pool`, only ages what that pool handed out
+  void sweep(InternPool pool, uint32_t maxAge = 8)
+  {
+    size_t index = static_cast<size_t>(pool);
+    uint8_t bit = static_cast<uint8_t>(1 << index);
+    epochs[index]++;
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+      Entry& entry = it->second;
+      if ((entry.pools & bit) && epochs[index] - entry.lastUsed[index] > maxAge)
+      {
+        entry.pools &= ~bit;
+      }
+      it = entry.pools == 0 ? entries.erase(it) : std::next(it);
+    }
+  }
+
+private:
+  struct Entry
+  {
+    Nan::Global<v8::String> value;
+    uint32_t lastUsed[internPools] = {};
+    uint8_t pools = 0; // Bit per InternPool that handed the string out within its `maxAge`
+  };
+
+  uint32_t epochs[internPools] = {};
+  std::unordered_map<std::wstring, Entry> entries;
+
+  void use(Entry& entry, InternPool pool)
+  {
+    size_t index = static_cast<size_t>(pool);
+    entry.lastUsed[index] = epochs[index];
+    entry.pools |= static_cast<uint8_t>(1 << index);
+  }
+
+  static std::unique_ptr<JsStringInterner>& holder()
+  {
+    static std::unique_ptr<JsStringInterner> interner;
+    return interner;
+  }
+};
+
+// Converts a batch of wide strings to JS strings with a single transcoding pass into one buffer.
+// Queued strings are referenced, not copied, so they must outlive build().
+class JsStringBatch
+{
+public:
+  explicit JsStringBatch(size_t expected = 0)
+  {
+    strings.reserve(expected);
+    pending.reserve(expected);
+  }
+
+  // Queues a string and returns its slot
+  size_t add(const std::wstring& value)
+  {
+    size_t slot = strings.size();
+    strings.emplace_back();
+    pending.push_back(Pending{slot, &value, false, InternPool::Sessions});
+    return slot;
+  }
+
+  // Queues a string interned in `pool`. Strings already known to the interner are resolved right
+  // away and skip transcoding, strings repeating within the batch are transcoded once.
+  size_t add(const std::wstring& value, InternPool pool)
+  {
+    size_t slot = strings.size();
+    strings.emplace_back();
+    if (JsStringInterner::shared().find(value, pool, strings[slot]))
+    {
+      return slot;
+    }
+    auto first = queued.emplace(std::wstring_view(value), pending.size());
+    if (!first.second && pending[first.first->second].pool == pool)
+    {
+      repeats.push_back(Repeat{slot, pending[first.first->second].slot});
+      return slot;
+    }
+    pending.push_back(Pending{slot, &value, true, pool});
+    return slot;
+  }
+
+  void build()
+  {
+    std::vector<Utf16View> views(pending.size());
+    for (size_t i = 0; i < pending.size(); i++)
+    {
+      // wchar_t is UTF-16 on Windows
+      views[i] = Utf16View{reinterpret_cast<const uint16_t*>(pending[i].source->c_str()), pending[i].source->size()};
+    }
+
+    std::vector<char> bytes;
+    std::vector<TranscodedSpan> spans;
+    transcodeAll(views.data(), views.size(), bytes, spans);
+
+    v8::Isolate* isolate = v8::Isolate::GetCurrent();
+    for (size_t i = 0; i < pending.size(); i++)
+    {
+      const TranscodedSpan& span = spans[i];
+      const char* data = bytes.data() + span.offset;
+      v8::Local<v8::String> value = span.latin1
+        ? v8::String::NewFromOneByte(isolate, reinterpret_cast<const uint8_t*>(data), v8::NewStringType::kNormal, static_cast<int>(span.length)).ToLocalChecked()
+        : Nan::New(data, static_cast<int>(span.length)).ToLocalChecked();
+
+      strings[pending[i].slot] = value;
+      if (pending[i].intern)
+      {
+        JsStringInterner::shared().store(*pending[i].source, pending[i].pool, value);
+      }
+    }
+    for (const Repeat& repeat : repeats)
+    {
+      strings[repeat.slot] = strings[repeat.first];
+    }
+    pending.clear();
+    queued.clear();
+    repeats.clear();
+  }
+
+  v8::Local<v8::String> operator[](size_t slot) const
+  {
+    return strings[slot];
+  }
+
+private:
+  struct Pending
+  {
+    size_t slot;
+    const std::wstring* source;
+    bool intern;
+    InternPool pool;
+  };
+
+  struct Repeat
+  {
+    size_t slot;
+    size_t first; // Slot of the queued occurrence
+  };
+
+  std::vector<v8::Local<v8::String>> strings;
+  std::vector<Pending> pending;
+  std::unordered_map<std::wstring_view, size_t> queued; // Interned strings pending, to their index in `pending`
+  std::vector<Repeat> repeats;
+};
@@ -0,0 +1,111 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// Latencies in microseconds, counted in four linear buckets per octave from 1 us up to about 67
+// seconds, so percentiles are within 25% of the true value at any scale with fixed memory.
+class LatencyHistogram
+{
+public:
+  static const size_t subBuckets = 4;
+  static const size_t octaves = 26;
+  static const size_t bucketCount = octaves * subBuckets;
+
+  void record(uint64_t micros)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    counts[bucketOf(micros)]++;
+    total++;
+    sum += micros;
+    minimum = total == 1 ? micros : std::min(minimum, micros);
+    maximum = std::max(maximum, micros);
+  }
+
+  // Upper bound of the bucket holding the `fraction` quantile, 0 when empty
+  uint64_t percentile(double fraction) const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (total == 0)
+    {
+      return 0;
+    }
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(fraction * total + 0.5));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < bucketCount; bucket++)
+    {
+      seen += counts[bucket];
+      if (seen >= rank)
+      {
+        return std::min(maximum, upperBound(bucket));
+      }
+    }
+    return maximum;
+  }
+
+  // Consistent copy of the counters
+  struct Snapshot
+  {
+    uint64_t counts[bucketCount];
+    uint64_t total;
+    uint64_t sum;
+    uint64_t minimum;
+    uint64_t maximum;
+  };
+
+  Snapshot snapshot() const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    Snapshot copy;
+    std::copy(counts, counts + bucketCount, copy.counts);
+    copy.total = total;
+    copy.sum = sum;
+    copy.minimum = minimum;
+    copy.maximum = maximum;
+    return copy;
+  }
+
+  void reset()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::fill(counts, counts + bucketCount, 0);
+    total = sum = minimum = maximum = 0;
+  }
+
+  // Largest latency counted in `bucket`
+  static uint64_t upperBound(size_t bucket)
+  {
+    size_t octave = bucket / subBuckets;
+    uint64_t base = uint64_t(1) << octave;
+    return base + ((bucket % subBuckets + 1) * base + subBuckets - 1) / subBuckets - 1;
+  }
+
+private:
+  mutable std::mutex mutex;
+  uint64_t counts[bucketCount] = {};
+  uint64_t total = 0;
+  uint64_t sum = 0;
+  uint64_t minimum = 0;
+  uint64_t maximum = 0;
+
+  static size_t bucketOf(uint64_t micros)
+  {
+    if (micros < 1)
+    {
+      return 0;
+    }
+    size_t octave = 0;
+    while ((micros >> octave) > 1)
+    {
+      octave++;
+    }
+    if (octave >= octaves)
+    {
+      return bucketCount - 1;
+    }
+    uint64_t base = uint64_t(1) << octave;
+    size_t sub = static_cast<size_t>(((micros - base) * subBuckets) >> octave);
+    return octave * subBuckets + sub;
+  }
+};
@@ -0,0 +1,155 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+enum class LeaseControl : uint8_t
+{
+  Volume,
+  Mute,
+};
+
+static const size_t leaseControlCount = 2;
+
+// One process wanting to write a control, with the priority it asked for. Priorities are stored
+// plus one so that 0 marks a slot still being filled in.
+struct LeaseSlot
+{
+  std::atomic<uint32_t> pid;
+  std::atomic<uint32_t> priority;
+  std::atomic<uint64_t> created; // Creation time of the process, tells a reused pid apart
+  std::atomic<uint64_t> ticket;  // Join order, breaks ties between equal priorities
+};
+
+// Who may write the controls of one endpoint, in memory shared by every process controlling it.
+// The owner of a control is the live holder with the highest priority, the earliest of equal ones.
+// Nothing hands the lease over: every process derives the owner from the slots, so a holder
+// leaving or dying passes the control on at the next check. Dead holders found along the way are
+// evicted. Lock free, processes only ever compare and swap single slots.
+struct LeaseTable
+{
+  static const size_t maxHolders = 16;
+
+  struct Holder
+  {
+    int slot;
+    uint32_t pid;
+    uint32_t priority;
+    uint64_t created;
+    uint64_t ticket;
+  };
+
+  std::atomic<uint64_t> tickets;
+  LeaseSlot slots[leaseControlCount][maxHolders];
+
+  // The slot taken, -1 when every slot is held by a live process. owner() only evicts the dead
+  // holders outranking a live one, so a full row is swept of dead holders at any rank first.
+  template <typename IsAlive>
+  int join(LeaseControl control, uint32_t pid, uint64_t created, uint16_t priority, IsAlive isAlive)
+  {
+    int slot = take(control, pid, created, priority);
+    if (slot < 0 && sweep(control, isAlive) > 0)
+    {
+      slot = take(control, pid, created, priority);
+    }
+    return slot;
+  }
+
+  // Evicts every dead holder of `control`, returns how many
+  template <typename IsAlive>
+  size_t sweep(LeaseControl control, IsAlive isAlive)
+  {
+    size_t evicted = 0;
+    LeaseSlot* row = slots[static_cast<size_t>(control)];
+    for (size_t i = 0; i < maxHolders; i++)
+    {
+      uint32_t priority = row[i].priority.load(std::memory_order_acquire);
+      if (priority == 0)
+      {
+        continue;
+      }
+      Holder holder{static_cast<int>(i), row[i].pid.load(std::memory_order_relaxed), priority - 1, row[i].created.load(std::memory_order_relaxed), row[i].ticket.load(std::memory_order_relaxed)};
+      if (!isAlive(holder.pid, holder.created) && evict(control, holder))
+      {
+        evicted++;
+      }
+    }
+    return evicted;
+  }
+
+  void leave(LeaseControl control, int slot)
+  {
+    LeaseSlot& entry = slots[static_cast<size_t>(control)][slot];
+    entry.priority.store(0, std::memory_order_release);
+    entry.pid.store(0, std::memory_order_release);
+  }
+
+  // The owner of `control` into `owner`, false when nobody holds it. `isAlive(pid, created)` is
+  // asked about the holders outranking `self` only, so the owner checks itself for free.
+  template <typename IsAlive>
+  bool owner(LeaseControl control, int self, Holder& owner, IsAlive isAlive)
+  {
+    Holder holders[maxHolders];
+    size_t count = 0;
+    LeaseSlot* row = slots[static_cast<size_t>(control)];
+    for (size_t i = 0; i < maxHolders; i++)
+    {
+      uint32_t priority = row[i].priority.load(std::memory_order_acquire);
+      if (priority == 0)
+      {
+        continue;
+      }
+      holders[count++] = Holder{static_cast<int>(i), row[i].pid.load(std::memory_order_relaxed), priority - 1, row[i].created.load(std::memory_order_relaxed), row[i].ticket.load(std::memory_order_relaxed)};
+    }
+    std::sort(holders, holders + count, [](const Holder& a, const Holder& b) {
+      return a.priority != b.priority ? a.priority > b.priority : a.ticket < b.ticket;
+    });
+
+    for (size_t i = 0; i < count; i++)
+    {
+      if (holders[i].slot == self || isAlive(holders[i].pid, holders[i].created))
+      {
+        owner = holders[i];
+        return true;
+      }
+      evict(control, holders[i]);
+    }
+    return false;
+  }
+
+private:
+  int take(LeaseControl control, uint32_t pid, uint64_t created, uint16_t priority)
+  {
+    LeaseSlot* row = slots[static_cast<size_t>(control)];
+    for (size_t i = 0; i < maxHolders; i++)
+    {
+      uint32_t free = 0;
+      if (row[i].pid.compare_exchange_strong(free, pid))
+      {
+        row[i].created.store(created, std::memory_order_relaxed);
+        row[i].ticket.store(tickets.fetch_add(1) + 1, std::memory_order_relaxed);
+        row[i].priority.store(priority + 1u, std::memory_order_release);
+        return static_cast<int>(i);
+      }
+    }
+    return -1;
+  }
+
+  // Only clears the slot if it still holds the same join
+  bool evict(LeaseControl control, const Holder& holder)
+  {
+    LeaseSlot& entry = slots[static_cast<size_t>(control)][holder.slot];
+    if (entry.ticket.load(std::memory_order_acquire) != holder.ticket)
+    {
+      return false;
+    }
+    uint32_t priority = holder.priority + 1;
+    if (entry.priority.compare_exchange_strong(priority, 0))
+    {
+      entry.pid.store(0, std::memory_order_release);
+      return true;
+    }
+    return false;
+  }
+};
@@ -0,0 +1,111 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// Mutexes whose contention is counted, by the class owning them. Instances of one class add up
+enum class LockSite
+{
+  EventQueue,
+  VolumeHistory,
+  StatePublisher,
+  ProcessNameCache,
+  DefaultDeviceCache,
+  DeviceMetadataCache,
+  EndpointNotifier,
+  SessionFocus,
+  VolumeControl, // Controllers built with MutexLocking
+};
+
+static const size_t lockSites = 9;
+
+struct LockCounters
+{
+  std::atomic<uint64_t> acquired;
+  std::atomic<uint64_t> contended; // Acquisitions that found the mutex held and waited
+  std::atomic<uint64_t> waitedMicros;
+};
+
+inline LockCounters& lockCounters(LockSite site)
+{
+  static LockCounters counters[lockSites];
+  return counters[static_cast<size_t>(site)];
+}
+
+inline const char* lockSiteName(LockSite site)
+{
+  switch (site)
+  {
+    case LockSite::EventQueue:
+      return "EventQueue";
+    case LockSite::VolumeHistory:
+      return "VolumeHistory";
+    case LockSite::StatePublisher:
+      return "StatePublisher";
+    case LockSite::ProcessNameCache:
+      return "ProcessNameCache";
+    case LockSite::DefaultDeviceCache:
+      return "DefaultDeviceCache";
+    case LockSite::DeviceMetadataCache:
+      return "DeviceMetadataCache";
+    case LockSite::EndpointNotifier:
+      return "EndpointNotifier";
+    case LockSite::SessionFocus:
+      return "SessionFocus";
+    default:
+      return "VolumeControl";
+  }
+}
+
+// A mutex counting its acquisitions into the counters of `site`. An uncontended lock costs a
+// try_lock and a relaxed increment, the clock is only read when the lock has to wait.
+template<typename Mutex>
+class BasicCountedMutex
+{
+public:
+  explicit BasicCountedMutex(LockSite site) : counters(lockCounters(site))
+  {
+  }
+
+  BasicCountedMutex(const BasicCountedMutex&) = delete;
+  BasicCountedMutex& operator=(const BasicCountedMutex&) = delete;
+
+  void lock()
+  {
+    counters.acquired.fetch_add(1, std::memory_order_relaxed);
+    if (mutex.try_lock())
+    {
+      return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    mutex.lock();
+    auto waited = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    counters.contended.fetch_add(1, std::memory_order_relaxed);
+    counters.waitedMicros.fetch_add(static_cast<uint64_t>(waited.count()), std::memory_order_relaxed);
+  }
+
+  bool try_lock()
+  {
+    bool locked = mutex.try_lock();
+    if (locked)
+    {
+      counters.acquired.fetch_add(1, std::memory_order_relaxed);
+    }
+    return locked;
+  }
+
+  void unlock()
+  {
+    mutex.unlock();
+  }
+
+private:
+  Mutex mutex;
+  LockCounters& counters;
+};
+
+typedef BasicCountedMutex<std::mutex> CountedMutex;
+// Reentered locks count as acquisitions as well, they never wait
+typedef BasicCountedMutex<std::recursive_mutex> CountedRecursiveMutex;
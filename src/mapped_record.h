@@ -0,0 +1,67 @@
+#pragma once
+#include <windows.h>
+#include <string>
+#include "check_errors.h"
+
+// A plain struct backed by a memory mapped file, so writes are plain stores and survive a
+// restart. A file created here starts out zero filled.
+template <typename T>
+class MappedRecord
+{
+public:
+  explicit MappedRecord(const std::wstring& path)
+  {
+    file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+      checkErrors(HRESULT_FROM_WIN32(GetLastError()), "opening the record file");
+    }
+
+    mapping = CreateFileMappingW(file, NULL, PAGE_READWRITE, 0, sizeof(T), NULL);
+    if (mapping != NULL)
+    {
+      view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(T));
+    }
+    if (view == NULL)
+    {
+      HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+      close();
+      checkErrors(hr, "mapping the record file");
+    }
+  }
+
+  ~MappedRecord()
+  {
+    close();
+  }
+
+  MappedRecord(const MappedRecord&) = delete;
+  MappedRecord& operator=(const MappedRecord&) = delete;
+
+  T& get()
+  {
+    return *static_cast<T*>(view);
+  }
+
+private:
+  HANDLE file = INVALID_HANDLE_VALUE;
+  HANDLE mapping = NULL;
+  void* view = NULL;
+
+  void close()
+  {
+    if (view != NULL)
+    {
+      FlushViewOfFile(view, sizeof(T));
+      UnmapViewOfFile(view);
+    }
+    if (mapping != NULL)
+    {
+      CloseHandle(mapping);
+    }
+    if (file != INVALID_HANDLE_VALUE)
+    {
+      CloseHandle(file);
+    }
+  }
+};
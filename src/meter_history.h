@@ -0,0 +1,289 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Aggregates of peak meter samples over a window
+struct MeterWindow
+{
+  float minimum;
+  float maximum;
+  float average;
+  float percentile;  // Resolved to the 1.5 dB histogram bin, like the threshold
+  double timeAboveMs; // Time the peak spent above the threshold
+  uint32_t count;
+};
+
+// Ring of peak meter samples with precomputed summaries of every 64-sample block, kept in a
+// segment tree. A window query scans at most the samples of its two edge blocks and the block
+// being written, everything in between comes from O(log n) tree nodes. Percentiles and the time
+// above a threshold use a 64-bin histogram on a dBFS scale, so they resolve to 1.5 dB.
+class MeterHistory
+{
+public:
+  static const size_t blockSize = 64;
+  static const size_t bins = 64;
+  static constexpr float binWidthDb = 1.5f;
+  static constexpr float floorDb = -96.0f;
+
+  // `samples` is rounded up to whole blocks
+  explicit MeterHistory(size_t samples = 65536)
+    : blockCount((samples + blockSize - 1) / blockSize),
+      capacity(blockCount * blockSize),
+      times(blockCount * blockSize),
+      levels(blockCount * blockSize)
+  {
+    leaves = 1;
+    while (leaves < blockCount)
+    {
+      leaves *= 2;
+    }
+    tree.resize(leaves * 2);
+  }
+
+  void push(uint64_t timeMs, float peak)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == 0)
+    {
+      baseTime = timeMs;
+    }
+    else if (timeMs - baseTime > UINT32_MAX / 2)
+    {
+      rebase();
+    }
+
+    size_t slot = (start + count) % capacity;
+    if (count == capacity)
+    {
+      start = (start + 1) % capacity;
+    }
+    else
+    {
+      count++;
+    }
+
+    // Starting a block drops the summary of the samples it overwrites
+    size_t block = slot / blockSize;
+    if (slot % blockSize == 0)
+    {
+      tree[leaves + block] = Summary();
+      rebuild(block);
+    }
+
+    times[slot] = static_cast<uint32_t>(timeMs - baseTime);
+    levels[slot] = quantize(peak);
+    for (size_t node = leaves + block; node > 0; node /= 2)
+    {
+      tree[node].add(levels[slot]);
+    }
+  }
+
+  MeterWindow query(uint64_t fromMs, uint64_t toMs, float threshold, float percentile) const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    Summary total;
+    size_t first = lowerBound(fromMs);
+    size_t last = toMs == UINT64_MAX ? count : lowerBound(toMs + 1); // One past the window
+    size_t headBlock = count == 0 ? SIZE_MAX : physical(count - 1) / blockSize;
+
+    size_t i = first;
+    while (i < last)
+    {
+      size_t slot = physical(i);
+      size_t block = slot / blockSize;
+      if (slot % blockSize != 0 || block == headBlock || i + blockSize > last)
+      {
+        total.add(levels[slot]);
+        i++;
+        continue;
+      }
+
+      // A run of whole blocks, contiguous in the ring until it wraps
+      size_t runStart = block;
+      size_t runEnd = block;
+      i += blockSize;
+      while (i + blockSize <= last && physical(i) == (runEnd + 1) * blockSize && runEnd + 1 != headBlock)
+      {
+        runEnd++;
+        i += blockSize;
+      }
+      queryTree(runStart, runEnd, total);
+    }
+
+    MeterWindow window = {};
+    window.count = total.count;
+    if (total.count == 0)
+    {
+      return window;
+    }
+
+    double span = static_cast<double>(times[physical(last - 1)]) - times[physical(first)];
+    double sampleMs = total.count > 1 ? span / (total.count - 1) : 0.0;
+    uint32_t thresholdBin = binOf(quantize(threshold));
+    uint32_t above = 0;
+    for (size_t bin = thresholdBin + 1; bin < bins; bin++)
+    {
+      above += total.histogram[bin];
+    }
+
+    window.minimum = dequantize(total.minimum);
+    window.maximum = dequantize(total.maximum);
+    window.average = static_cast<float>(static_cast<double>(total.sum) / total.count / 65535.0);
+    window.percentile = std::min(window.maximum, std::max(window.minimum, percentileOf(total, percentile)));
+    window.timeAboveMs = above * sampleMs;
+    return window;
+  }
+
+  size_t size() const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return count;
+  }
+
+private:
+  struct Summary
+  {
+    uint16_t minimum = UINT16_MAX;
+    uint16_t maximum = 0;
+    uint32_t count = 0;
+    uint64_t sum = 0;
+    uint32_t histogram[bins] = {};
+
+    void add(uint16_t level)
+    {
+      minimum = std::min(minimum, level);
+      maximum = std::max(maximum, level);
+      count++;
+      sum += level;
+      histogram[binOf(level)]++;
+    }
+
+    void merge(const Summary& other)
+    {
+      minimum = std::min(minimum, other.minimum);
+      maximum = std::max(maximum, other.maximum);
+      count += other.count;
+      sum += other.sum;
+      for (size_t bin = 0; bin < bins; bin++)
+      {
+        histogram[bin] += other.histogram[bin];
+      }
+    }
+  };
+
+  size_t blockCount;
+  size_t capacity;
+  size_t leaves;
+  mutable std::mutex mutex;
+  std::vector<uint32_t> times; // ms since baseTime
+  std::vector<uint16_t> levels; // Peak scaled to 0..65535
+  std::vector<Summary> tree;   // Heap layout, block summaries from index `leaves`
+  uint64_t baseTime = 0;
+  size_t start = 0;
+  size_t count = 0;
+
+  static uint16_t quantize(float peak)
+  {
+    return static_cast<uint16_t>(std::lround(std::min(1.0f, std::max(0.0f, peak)) * 65535.0f));
+  }
+
+  static float dequantize(uint16_t level)
+  {
+    return level / 65535.0f;
+  }
+
+  static uint32_t binOf(uint16_t level)
+  {
+    if (level == 0)
+    {
+      return 0;
+    }
+    float db = 20.0f * std::log10(level / 65535.0f);
+    return static_cast<uint32_t>(std::min<float>(bins - 1, std::max(0.0f, (db - floorDb) / binWidthDb)));
+  }
+
+  static float percentileOf(const Summary& summary, float percentile)
+  {
+    uint64_t rank = static_cast<uint64_t>(std::ceil(std::min(1.0f, std::max(0.0f, percentile)) * summary.count));
+    uint64_t seen = 0;
+    for (size_t bin = 0; bin < bins; bin++)
+    {
+      seen += summary.histogram[bin];
+      if (seen >= rank && seen > 0)
+      {
+        float db = floorDb + (bin + 0.5f) * binWidthDb;
+        return std::pow(10.0f, db / 20.0f);
+      }
+    }
+    return dequantize(summary.maximum);
+  }
+
+  size_t physical(size_t logical) const
+  {
+    return (start + logical) % capacity;
+  }
+
+  // First logical index whose time is at or after `timeMs`
+  size_t lowerBound(uint64_t timeMs) const
+  {
+    if (timeMs <= baseTime)
+    {
+      return 0;
+    }
+    uint64_t offset = timeMs - baseTime;
+    size_t low = 0;
+    size_t high = count;
+    while (low < high)
+    {
+      size_t middle = (low + high) / 2;
+      if (times[physical(middle)] < offset)
+      {
+        low = middle + 1;
+      }
+      else
+      {
+        high = middle;
+      }
+    }
+    return low;
+  }
+
+  // Keeps the 32-bit sample times from overflowing on long runs, once every few weeks
+  void rebase()
+  {
+    uint32_t oldest = times[start];
+    for (size_t i = 0; i < count; i++)
+    {
+      times[physical(i)] -= oldest;
+    }
+    baseTime += oldest;
+  }
+
+  void rebuild(size_t block)
+  {
+    for (size_t node = (leaves + block) / 2; node > 0; node /= 2)
+    {
+      tree[node] = tree[node * 2];
+      tree[node].merge(tree[node * 2 + 1]);
+    }
+  }
+
+  void queryTree(size_t firstBlock, size_t lastBlock, Summary& total) const
+  {
+    for (size_t low = leaves + firstBlock, high = leaves + lastBlock + 1; low < high; low /= 2, high /= 2)
+    {
+      if (low & 1)
+      {
+        total.merge(tree[low++]);
+      }
+      if (high & 1)
+      {
+        total.merge(tree[--high]);
+      }
+    }
+  }
+};
@@ -0,0 +1,219 @@
+#pragma once
+#include <windows.h>
+#include <mmdeviceapi.h>
+#include <endpointvolume.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <wrl/client.h>
+#include "check_errors.h"
+#include "clock.h"
+#include "event_queue.h"
+#include "exposure_dose.h"
+#include "meter_history.h"
+#include "object_counts.h"
+#include "silence_detector.h"
+#include "volume_listeners.h"
+
+// Polls the peak meter of one endpoint on its own thread and feeds a MeterHistory. The meter is
+// activated on the sampling thread, in its own multithreaded apartment. An attached exposure
+// dose is fed from the same samples. With silence detection on, the thread backs off to sampling
+// every `maxIntervalMs` during silence and returns to the full rate as soon as signal comes back.
+// Events go to `events`.
+class MeterSampler
+{
+public:
+  MeterSampler(const std::wstring& deviceId, DWORD intervalMs, size_t capacity, std::shared_ptr<EventQueue> events)
+    : deviceId(deviceId), intervalMs(intervalMs), samples(capacity), events(std::move(events))
+  {
+    std::promise<HRESULT> started;
+    std::future<HRESULT> result = started.get_future();
+    thread = std::thread(&MeterSampler::run, this, std::move(started));
+
+    HRESULT hr = result.get();
+    if (FAILED(hr))
+    {
+      thread.join();
+      checkErrors(hr, "Error when trying to get a handle to the peak meter");
+    }
+  }
+
+  ~MeterSampler()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    thread.join();
+  }
+
+  MeterSampler(const MeterSampler&) = delete;
+  MeterSampler& operator=(const MeterSampler&) = delete;
+
+  const MeterHistory& history() const
+  {
+    return samples;
+  }
+
+  void setExposure(std::shared_ptr<ExposureDose> dose)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    exposure = std::move(dose);
+    gainChanged = true;
+  }
+
+  void setSilenceDetection(bool enabled, const SilenceDetector::Settings& settings)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    silence.reset(enabled ? new SilenceDetector(settings) : nullptr);
+    silent = false;
+    interrupted = true; // Back to the full rate right away
+    wake.notify_all();
+  }
+
+  bool isSilent() const
+  {
+    return silent;
+  }
+
+private:
+  std::wstring deviceId;
+  DWORD intervalMs;
+  MeterHistory samples;
+  std::shared_ptr<EventQueue> events;
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool stopping = false;
+  bool interrupted = false;
+  std::shared_ptr<ExposureDose> exposure;
+  std::atomic<bool> gainChanged{true}; // The exposure dose needs the endpoint gain read again
+  std::unique_ptr<SilenceDetector> silence;
+  std::atomic<bool> silent{false};
+  ObjectCount<NativeObject::MeterSampler> counted;
+
+  void run(std::promise<HRESULT> started)
+  {
+    CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    {
+      Microsoft::WRL::ComPtr<IAudioMeterInformation> meter;
+      Microsoft::WRL::ComPtr<IAudioEndpointVolume> volume;
+      Microsoft::WRL::ComPtr<EndpointVolumeListener> volumeListener;
+      HRESULT hr = activate(meter, volume);
+      if (SUCCEEDED(hr))
+      {
+        volumeListener.Attach(new EndpointVolumeListener([this](const AUDIO_VOLUME_NOTIFICATION_DATA&) {
+          gainChanged = true;
+        }));
+        hr = volume->RegisterControlChangeNotify(volumeListener.Get());
+      }
+      started.set_value(hr);
+
+      float minimumDb = 0, maximumDb = 0, stepDb = 0;
+      if (SUCCEEDED(hr))
+      {
+        volume->GetVolumeRange(&minimumDb, &maximumDb, &stepDb);
+      }
+
+      uint64_t previous = unixTimeMs();
+      DWORD waitMs = intervalMs;
+      std::unique_lock<std::mutex> lock(mutex);
+      while (SUCCEEDED(hr) && !stopping)
+      {
+        std::shared_ptr<ExposureDose> dose = exposure;
+        lock.unlock();
+        float peak = 0;
+        uint64_t now = unixTimeMs();
+        bool sampled = SUCCEEDED(meter->GetPeakValue(&peak));
+        if (sampled)
+        {
+          samples.push(now, peak);
+          if (dose)
+          {
+            accumulate(*dose, *volume.Get(), maximumDb, now, peak, now - std::min(now, previous));
+          }
+        }
+        previous = now;
+        lock.lock();
+
+        waitMs = sampled && silence ? detectSilence(*silence, now, peak, waitMs) : intervalMs;
+        wake.wait_for(lock, std::chrono::milliseconds(waitMs), [this] { return stopping || interrupted; });
+        interrupted = false;
+      }
+
+      if (volumeListener)
+      {
+        volume->UnregisterControlChangeNotify(volumeListener.Get());
+      }
+    }
+    CoUninitialize();
+  }
+
+  void accumulate(ExposureDose& dose, IAudioEndpointVolume& volume, float maximumDb, uint64_t now, float peak, uint64_t elapsedMs)
+  {
+    if (gainChanged.exchange(false))
+    {
+      float levelDb = maximumDb;
+      BOOL muted = FALSE;
+      volume.GetMasterVolumeLevel(&levelDb);
+      volume.GetMute(&muted);
+      dose.setGain(levelDb - maximumDb, muted != FALSE);
+    }
+
+    // A stalled thread must not count as a long stretch at the latest level
+    double heldMs = static_cast<double>(std::min<uint64_t>(elapsedMs, 4 * intervalMs));
+    uint32_t crossed = dose.add(localDay(now), peak, heldMs);
+    for (size_t i = 0; crossed != 0; i++, crossed >>= 1)
+    {
+      if (crossed & 1)
+      {
+        events->push(AudioEvent{AudioEventType::ExposureThreshold, now, 0, dose.dose(localDay(now)), dose.threshold(i)});
+      }
+    }
+  }
+
+  // Runs under the lock, returns the time to wait for the next sample
+  DWORD detectSilence(SilenceDetector& detector, uint64_t now, float peak, DWORD waitMs)
+  {
+    switch (detector.update(now, peak))
+    {
+      case SilenceDetector::Transition::Started:
+        events->push(AudioEvent{AudioEventType::SilenceStarted, now, 0, static_cast<double>(detector.silentSince()), 0});
+        break;
+      case SilenceDetector::Transition::Ended:
+        events->push(AudioEvent{AudioEventType::SilenceEnded, now, 0, static_cast<double>(detector.silentSince()), 0});
+        break;
+      default:
+        break;
+    }
+    silent = detector.isSilent();
+    return detector.interval(intervalMs, waitMs);
+  }
+
+  HRESULT activate(Microsoft::WRL::ComPtr<IAudioMeterInformation>& meter, Microsoft::WRL::ComPtr<IAudioEndpointVolume>& volume)
+  {
+    Microsoft::WRL::ComPtr<IMMDeviceEnumerator> enumerator;
+    Microsoft::WRL::ComPtr<IMMDevice> device;
+    HRESULT hr = CoCreateInstance(__uuidof(MMDeviceEnumerator), NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&enumerator));
+    if (SUCCEEDED(hr))
+    {
+      hr = enumerator->GetDevice(deviceId.c_str(), &device);
+    }
+    if (SUCCEEDED(hr))
+    {
+      hr = device->Activate(__uuidof(IAudioMeterInformation), CLSCTX_INPROC_SERVER, NULL, &meter);
+    }
+    if (SUCCEEDED(hr))
+    {
+      hr = device->Activate(__uuidof(IAudioEndpointVolume), CLSCTX_INPROC_SERVER, NULL, &volume);
+    }
+    return hr;
+  }
+};
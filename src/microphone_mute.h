@@ -0,0 +1,267 @@
+#pragma once
+#include <windows.h>
+#include <mmdeviceapi.h>
+#include <endpointvolume.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <wrl/client.h>
+#include "check_errors.h"
+#include "clock.h"
+#include "event_queue.h"
+#include "latency_histogram.h"
+#include "object_counts.h"
+#include "volume_listeners.h"
+
+// Mute toggling for a microphone with the endpoint volume activated up front and a worker thread
+// issuing the calls, so a request costs the caller a queue push. Every SetMute carries a context
+// GUID holding the request id, and a request only completes when the endpoint notification with
+// that context arrives, or fails after `timeoutMs`. Request to confirmation latencies are kept in a
+// histogram. Completions go to `completions` with the request id as target.
+class MicrophoneMute
+{
+public:
+  enum class Command
+  {
+    Unmute,
+    Mute,
+    Toggle,
+  };
+
+  static const uint64_t timeoutMs = 1000;
+
+  // The default communications microphone when `deviceId` is empty
+  MicrophoneMute(const std::wstring& deviceId, std::shared_ptr<EventQueue> completions)
+    : deviceId(deviceId), completions(std::move(completions))
+  {
+    stopEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    commandEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+
+    std::promise<HRESULT> started;
+    std::future<HRESULT> result = started.get_future();
+    thread = std::thread(&MicrophoneMute::run, this, std::move(started));
+
+    HRESULT hr = result.get();
+    if (FAILED(hr))
+    {
+      thread.join();
+      CloseHandle(stopEvent);
+      CloseHandle(commandEvent);
+      checkErrors(hr, "Error when trying to get a handle to the microphone volume");
+    }
+  }
+
+  // Requests still pending are dropped without completing
+  ~MicrophoneMute()
+  {
+    SetEvent(stopEvent);
+    thread.join();
+    CloseHandle(stopEvent);
+    CloseHandle(commandEvent);
+  }
+
+  MicrophoneMute(const MicrophoneMute&) = delete;
+  MicrophoneMute& operator=(const MicrophoneMute&) = delete;
+
+  // Returns the request id the completion will carry, never 0
+  uint32_t request(Command command)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t id = ++lastRequest != 0 ? lastRequest : ++lastRequest;
+    commands.push_back(Request{id, command, false, std::chrono::steady_clock::now()});
+    SetEvent(commandEvent);
+    return id;
+  }
+
+  // The state reported by the latest endpoint notification
+  bool isMuted() const
+  {
+    return muted;
+  }
+
+  const LatencyHistogram& latencies() const
+  {
+    return histogram;
+  }
+
+private:
+  struct Request
+  {
+    uint32_t id;
+    Command command;
+    bool target;
+    std::chrono::steady_clock::time_point start;
+  };
+
+  std::wstring deviceId;
+  std::shared_ptr<EventQueue> completions;
+  HANDLE stopEvent;
+  HANDLE commandEvent;
+  std::thread thread;
+  std::mutex mutex;
+  std::deque<Request> commands;
+  std::vector<Request> pending; // Issued, waiting for their notification
+  uint32_t lastRequest = 0;
+  std::atomic<bool> muted{false};
+  LatencyHistogram histogram;
+  ObjectCount<NativeObject::MicrophoneMute> counted;
+
+  // Request ids go into Data1, the rest tells our notifications apart from everyone else's
+  static GUID contextFor(uint32_t id)
+  {
+    GUID context = {id, 0x5a1e, 0x4d0b, {0x8f, 0x7c, 0x3e, 0x2a, 0x9b, 0x6c, 0x1d, 0x40}};
+    return context;
+  }
+
+  static bool isOwnContext(const GUID& context)
+  {
+    GUID own = contextFor(context.Data1);
+    return IsEqualGUID(context, own) != FALSE;
+  }
+
+  void run(std::promise<HRESULT> started)
+  {
+    CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    {
+      Microsoft::WRL::ComPtr<IAudioEndpointVolume> volume;
+      Microsoft::WRL::ComPtr<EndpointVolumeListener> listener;
+      HRESULT hr = activate(volume);
+      BOOL initial = FALSE;
+      if (SUCCEEDED(hr))
+      {
+        hr = volume->GetMute(&initial);
+        muted = initial != FALSE;
+      }
+      if (SUCCEEDED(hr))
+      {
+        listener.Attach(new EndpointVolumeListener([this](const AUDIO_VOLUME_NOTIFICATION_DATA& data) {
+          confirm(data);
+        }));
+        hr = volume->RegisterControlChangeNotify(listener.Get());
+      }
+      started.set_value(hr);
+
+      bool intended = muted; // Toggles flip what was asked for last, not what was confirmed
+      HANDLE waits[] = {stopEvent, commandEvent};
+      while (SUCCEEDED(hr))
+      {
+        DWORD timeout;
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          timeout = pending.empty() ? INFINITE : 50;
+        }
+        DWORD woken = WaitForMultipleObjects(2, waits, FALSE, timeout);
+        if (woken == WAIT_OBJECT_0 || woken == WAIT_FAILED)
+        {
+          break;
+        }
+        issue(*volume.Get(), intended);
+        expire();
+      }
+
+      if (listener)
+      {
+        volume->UnregisterControlChangeNotify(listener.Get());
+      }
+    }
+    CoUninitialize();
+  }
+
+  void issue(IAudioEndpointVolume& volume, bool& intended)
+  {
+    std::deque<Request> batch;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      batch.swap(commands);
+      if (pending.empty())
+      {
+        intended = muted;
+      }
+    }
+
+    for (Request& request : batch)
+    {
+      request.target = request.command == Command::Toggle ? !intended : request.command == Command::Mute;
+      intended = request.target;
+      {
+        // Pending before the call, the notification can arrive before SetMute returns
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back(request);
+      }
+
+      GUID context = contextFor(request.id);
+      HRESULT hr = volume.SetMute(request.target ? TRUE : FALSE, &context);
+      if (hr == S_FALSE || FAILED(hr))
+      {
+        // Already in that state, no notification follows
+        std::lock_guard<std::mutex> lock(mutex);
+        complete(request.id, SUCCEEDED(hr));
+      }
+    }
+  }
+
+  // Runs on a COM worker thread
+  void confirm(const AUDIO_VOLUME_NOTIFICATION_DATA& data)
+  {
+    muted = data.bMuted != FALSE;
+    if (isOwnContext(data.guidEventContext))
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      complete(data.guidEventContext.Data1, true);
+    }
+  }
+
+  void expire()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto now = std::chrono::steady_clock::now();
+    while (!pending.empty() && now - pending.front().start > std::chrono::milliseconds(timeoutMs))
+    {
+      complete(pending.front().id, false);
+    }
+  }
+
+  // Called under the lock
+  void complete(uint32_t id, bool confirmed)
+  {
+    for (auto it = pending.begin(); it != pending.end(); ++it)
+    {
+      if (it->id != id)
+      {
+        continue;
+      }
+      auto elapsed = std::chrono::steady_clock::now() - it->start;
+      uint64_t micros = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+      if (confirmed)
+      {
+        histogram.record(micros);
+      }
+      AudioEventType type = confirmed ? AudioEventType::MuteConfirmed : AudioEventType::MuteFailed;
+      completions->push(AudioEvent{type, unixTimeMs(), id, micros / 1000.0, it->target ? 1.0 : 0.0});
+      pending.erase(it);
+      return;
+    }
+  }
+
+  HRESULT activate(Microsoft::WRL::ComPtr<IAudioEndpointVolume>& volume)
+  {
+    Microsoft::WRL::ComPtr<IMMDeviceEnumerator> enumerator;
+    Microsoft::WRL::ComPtr<IMMDevice> device;
+    HRESULT hr = CoCreateInstance(__uuidof(MMDeviceEnumerator), NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&enumerator));
+    if (SUCCEEDED(hr))
+    {
+      hr = deviceId.empty() ? enumerator->GetDefaultAudioEndpoint(eCapture, eCommunications, &device) : enumerator->GetDevice(deviceId.c_str(), &device);
+    }
+    if (SUCCEEDED(hr))
+    {
+      hr = device->Activate(__uuidof(IAudioEndpointVolume), CLSCTX_INPROC_SERVER, NULL, &volume);
+    }
+    return hr;
+  }
+};
@@ -0,0 +1,188 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+enum class MixerControl : uint8_t
+{
+  DeviceVolume,
+  DeviceMute,
+  SessionVolume,
+  SessionMute,
+};
+
+// One applied change. Mutes are stored as 0 or 1 so every control fits the same record.
+struct JournalRecord
+{
+  uint64_t time;    // Milliseconds, of the latest change coalesced into the record
+  uint32_t group;   // Records of one batch operation share a group and are undone together
+  uint32_t target;  // Session handle, 0 for the device itself
+  float before;
+  float after;
+  MixerControl control;
+};
+
+// Undo/redo history of mixer changes as compact delta records. Repeated changes of one control
+// within `coalesceMs`, like the stream of values from a dragged slider, collapse into a single
+// record, and at most `capacity` records are kept before the oldest groups are dropped.
+class MixerJournal
+{
+public:
+  explicit MixerJournal(size_t capacity = 512, uint64_t coalesceMs = 500)
+    : capacity(capacity), coalesceMs(coalesceMs)
+  {
+  }
+
+  // Changes recorded until endGroup() form one undo step
+  void beginGroup()
+  {
+    openGroup = ++lastGroup;
+  }
+
+  void endGroup()
+  {
+    openGroup = 0;
+  }
+
+  void record(MixerControl control, uint32_t target, float before, float after, uint64_t now)
+  {
+    // Recording after an undo forks the history, the undone steps cannot be redone anymore
+    records.erase(records.begin() + cursor, records.end());
+
+    if (openGroup == 0 && !records.empty())
+    {
+      JournalRecord& last = records.back();
+      bool alone = records.size() == 1 || records[records.size() - 2].group != last.group;
+      if (alone && last.control == control && last.target == target && now - last.time <= coalesceMs)
+      {
+        last.after = after;
+        last.time = now;
+        if (last.after == last.before)
+        {
+          records.pop_back(); // Dragged back to where it started
+        }
+        cursor = records.size();
+        return;
+      }
+    }
+
+    if (before == after)
+    {
+      return;
+    }
+
+    records.push_back(JournalRecord{now, openGroup != 0 ? openGroup : ++lastGroup, target, before, after, control});
+    trim();
+    cursor = records.size();
+  }
+
+  bool canUndo() const
+  {
+    return cursor > 0;
+  }
+
+  bool canRedo() const
+  {
+    return cursor < records.size();
+  }
+
+  // The newest applied step, newest record first, the caller writes back every `before` and then
+  // calls undone(). Nothing moves before that, so a step that failed to apply stays where it was.
+  std::vector<JournalRecord> nextUndo() const
+  {
+    std::vector<JournalRecord> step;
+    if (!canUndo())
+    {
+      return step;
+    }
+    uint32_t group = records[cursor - 1].group;
+    for (size_t at = cursor; at > 0 && records[at - 1].group == group; at--)
+    {
+      step.push_back(records[at - 1]);
+    }
+    return step;
+  }
+
+  // The oldest undone step, oldest record first, the caller writes every `after` again and then
+  // calls redone()
+  std::vector<JournalRecord> nextRedo() const
+  {
+    std::vector<JournalRecord> step;
+    if (!canRedo())
+    {
+      return step;
+    }
+    uint32_t group = records[cursor].group;
+    for (size_t at = cursor; at < records.size() && records[at].group == group; at++)
+    {
+      step.push_back(records[at]);
+    }
+    return step;
+  }
+
+  // Marks the step of nextUndo() as applied backwards
+  void undone(const std::vector<JournalRecord>& step)
+  {
+    cursor -= step.size();
+  }
+
+  void redone(const std::vector<JournalRecord>& step)
+  {
+    cursor += step.size();
+  }
+
+  void clear()
+  {
+    records.clear();
+    cursor = 0;
+  }
+
+  size_t size() const
+  {
+    return records.size();
+  }
+
+private:
+  size_t capacity;
+  uint64_t coalesceMs;
+  std::deque<JournalRecord> records;
+  size_t cursor = 0; // Records before the cursor are applied, the rest are undone
+  uint32_t lastGroup = 0;
+  uint32_t openGroup = 0;
+
+  // Drops whole groups from the front so an undo step is never left half recorded
+  void trim()
+  {
+    while (records.size() > capacity)
+    {
+      uint32_t group = records.front().group;
+      if (group == records.back().group)
+      {
+        break; // A single step larger than the journal is kept whole
+      }
+      while (!records.empty() && records.front().group == group)
+      {
+        records.pop_front();
+      }
+    }
+  }
+};
+
+// Scope of one batch operation in the journal
+class MixerJournalGroup
+{
+public:
+  explicit MixerJournalGroup(MixerJournal& journal) : journal(journal)
+  {
+    journal.beginGroup();
+  }
+
+  ~MixerJournalGroup()
+  {
+    journal.endGroup();
+  }
+
+private:
+  MixerJournal& journal;
+};
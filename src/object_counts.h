@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+// Kinds of native objects whose live instances are counted, so a long run can tell a leak apart
+// from a working set that merely grew
+enum class NativeObject
+{
+  VolumeControl,
+  EndpointVolumeListener,
+  SessionEventsListener,
+  EventDispatcher,
+  MeterSampler,
+  VoiceActivityMonitor,
+  MicrophoneMute,
+  EndpointLease,
+  SharedStateReader,
+};
+
+static const size_t nativeObjectKinds = 9;
+
+inline std::atomic<long>& liveObjects(NativeObject kind)
+{
+  static std::atomic<long> counts[nativeObjectKinds];
+  return counts[static_cast<size_t>(kind)];
+}
+
+inline const char* nativeObjectName(NativeObject kind)
+{
+  switch (kind)
+  {
+    case NativeObject::VolumeControl:
+      return "VolumeControl";
+    case NativeObject::EndpointVolumeListener:
+      return "EndpointVolumeListener";
+    case NativeObject::SessionEventsListener:
+      return "SessionEventsListener";
+    case NativeObject::EventDispatcher:
+      return "EventDispatcher";
+    case NativeObject::MeterSampler:
+      return "MeterSampler";
+    case NativeObject::VoiceActivityMonitor:
+      return "VoiceActivityMonitor";
+    case NativeObject::MicrophoneMute:
+      return "MicrophoneMute";
+    case NativeObject::EndpointLease:
+      return "EndpointLease";
+    default:
+      return "SharedStateReader";
+  }
+}
+
+// Member counting the live instances of its owner, copies included
+template <NativeObject kind>
+class ObjectCount
+{
+public:
+  ObjectCount()
+  {
+    liveObjects(kind)++;
+  }
+
+  ObjectCount(const ObjectCount&)
+  {
+    liveObjects(kind)++;
+  }
+
+  ObjectCount& operator=(const ObjectCount&) = default;
+
+  ~ObjectCount()
+  {
+    liveObjects(kind)--;
+  }
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include <windows.h>
+#include <cstdint>
+
+// Creation time of a process, tells a reused pid apart from the process that had it before
+inline uint64_t processCreated(HANDLE process)
+{
+  FILETIME created, exited, kernel, user;
+  if (!GetProcessTimes(process, &created, &exited, &kernel, &user))
+  {
+    return 0;
+  }
+  return (static_cast<uint64_t>(created.dwHighDateTime) << 32) | created.dwLowDateTime;
+}
+
+// Whether `pid` still runs the process created at `created`, any process of that pid when it is 0.
+// A process that cannot be opened for lack of rights is assumed to be running.
+inline bool isProcessAlive(uint32_t pid, uint64_t created)
+{
+  HANDLE process = OpenProcess(SYNCHRONIZE | PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+  if (process == NULL)
+  {
+    return GetLastError() == ERROR_ACCESS_DENIED;
+  }
+  bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT && (created == 0 || processCreated(process) == created);
+  CloseHandle(process);
+  return alive;
+}
@@ -0,0 +1,200 @@
+#pragma once
+#include <windows.h>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "lock_stats.h"
+
+// Resolves process ids to executable names (e.g. "chrome.exe") and remembers the result.
+// Each entry records the process creation time, so a recycled PID is resolved again instead of
+// reporting the previous owner's name. Processes that refuse to be opened are remembered as nameless
+// for `deniedMs`. Least recently used entries are evicted past `capacity`.
+class ProcessNameCache
+{
+public:
+  struct Stats
+  {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t size;
+  };
+
+  explicit ProcessNameCache(size_t capacity = 256, ULONGLONG deniedMs = 5000)
+    : capacity(capacity), deniedMs(deniedMs), counters{0, 0, 0, 0}
+  {
+  }
+
+  // Cache shared by every controller in the process
+  static ProcessNameCache& shared()
+  {
+    static ProcessNameCache cache;
+    return cache;
+  }
+
+  std::wstring resolve(DWORD pid)
+  {
+    std::lock_guard<CountedMutex> lock(mutex);
+    return resolveLocked(pid, GetTickCount64());
+  }
+
+  std::vector<std::wstring> resolveAll(const std::vector<DWORD>& pids)
+  {
+    std::vector<std::wstring> names;
+    names.reserve(pids.size());
+
+    std::lock_guard<CountedMutex> lock(mutex);
+    ULONGLONG now = GetTickCount64();
+    for (DWORD pid : pids)
+    {
+      names.push_back(resolveLocked(pid, now));
+    }
+    return names;
+  }
+
+  Stats stats() const
+  {
+    std::lock_guard<CountedMutex> lock(mutex);
+    Stats result = counters;
+    result.size = entries.size();
+    return result;
+  }
+
+  void clear()
+  {
+    std::lock_guard<CountedMutex> lock(mutex);
+    entries.clear();
+    lru.clear();
+  }
+
+private:
+  struct Entry
+  {
+    DWORD pid;
+    ULONGLONG startTime;
+    ULONGLONG checkedAt;
+    std::wstring name;
+    bool denied; // OpenProcess refused at `checkedAt`
+  };
+
+  using EntryList = std::list<Entry>;
+
+  size_t capacity;
+  ULONGLONG deniedMs;
+  mutable CountedMutex mutex{LockSite::ProcessNameCache};
+  EntryList lru; // Most recently used first
+  std::unordered_map<DWORD, EntryList::iterator> entries;
+  Stats counters;
+
+  std::wstring resolveLocked(DWORD pid, ULONGLONG now)
+  {
+    // PID 0 is the idle process, used by the system sounds session
+    if (pid == 0)
+    {
+      return std::wstring();
+    }
+
+    auto found = entries.find(pid);
+    if (found != entries.end() && found->second->denied && now - found->second->checkedAt < deniedMs)
+    {
+      counters.hits++;
+      lru.splice(lru.begin(), lru, found->second);
+      return std::wstring();
+    }
+
+    // PROCESS_QUERY_LIMITED_INFORMATION is enough for both the start time and the image name,
+    // and unlike PROCESS_QUERY_INFORMATION it is granted for most elevated processes too.
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (process == NULL)
+    {
+      counters.misses++;
+      // Protected processes stay inaccessible, asking again on every listing would only fail again
+      if (GetLastError() == ERROR_ACCESS_DENIED)
+      {
+        store(found, Entry{pid, 0, now, std::wstring(), true});
+        return std::wstring();
+      }
+
+      // The process is gone, so whatever we remembered about this PID is stale
+      if (found != entries.end())
+      {
+        lru.erase(found->second);
+        entries.erase(found);
+      }
+      return std::wstring();
+    }
+
+    ULONGLONG startTime = startTimeOf(process);
+    if (found != entries.end() && !found->second->denied && found->second->startTime == startTime)
+    {
+      CloseHandle(process);
+      counters.hits++;
+      found->second->checkedAt = now;
+      lru.splice(lru.begin(), lru, found->second);
+      return found->second->name;
+    }
+
+    std::wstring name = imageNameOf(process);
+    CloseHandle(process);
+    counters.misses++;
+
+    // Replaces an entry of the same PID, the id has been recycled or the process became accessible
+    store(found, Entry{pid, startTime, now, name, false});
+    return name;
+  }
+
+  void store(std::unordered_map<DWORD, EntryList::iterator>::iterator found, Entry entry)
+  {
+    if (found != entries.end())
+    {
+      *found->second = std::move(entry);
+      lru.splice(lru.begin(), lru, found->second);
+      return;
+    }
+
+    DWORD pid = entry.pid;
+    lru.push_front(std::move(entry));
+    entries[pid] = lru.begin();
+
+    while (entries.size() > capacity)
+    {
+      entries.erase(lru.back().pid);
+      lru.pop_back();
+      counters.evictions++;
+    }
+  }
+
+  static ULONGLONG startTimeOf(HANDLE process)
+  {
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(process, &creation, &exit, &kernel, &user))
+    {
+      return 0;
+    }
+    return (static_cast<ULONGLONG>(creation.dwHighDateTime) << 32) | creation.dwLowDateTime;
+  }
+
+  static std::wstring imageNameOf(HANDLE process)
+  {
+    std::vector<wchar_t> path(MAX_PATH);
+    DWORD size = static_cast<DWORD>(path.size());
+
+    // Long paths are rare, grow the buffer only when the first attempt did not fit
+    while (!QueryFullProcessImageNameW(process, 0, path.data(), &size))
+    {
+      if (GetLastError() != ERROR_INSUFFICIENT_BUFFER || path.size() >= 32768)
+      {
+        return std::wstring();
+      }
+      path.resize(path.size() * 2);
+      size = static_cast<DWORD>(path.size());
+    }
+
+    std::wstring fullPath(path.data(), size);
+    size_t separator = fullPath.find_last_of(L"\\/");
+    return separator == std::wstring::npos ? fullPath : fullPath.substr(separator + 1);
+  }
+};
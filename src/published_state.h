@@ -0,0 +1,159 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+struct PublishedSession
+{
+  uint32_t handle; // 0 for a free slot
+  uint32_t pid;
+  float volume;
+  uint8_t muted;
+  uint8_t state; // AudioSessionState
+  uint8_t flags; // SessionStateTable::Flags
+  uint8_t reserved;
+};
+
+// Device and session state as one process publishes it for others. Sessions sit at the slot index
+// of their handle, like in the session state table.
+struct PublishedSnapshot
+{
+  static const uint32_t currentMagic = 0x31534157; // "WAS1"
+  static const uint32_t maxSessions = 128;
+
+  uint32_t magic;
+  uint32_t publisherPid;
+  uint64_t updated; // Unix time in ms
+  float volume;
+  uint32_t muted;
+  uint32_t sessionCount; // Slots in use, free ones included
+  uint32_t reserved;
+  PublishedSession sessions[maxSessions];
+};
+
+// Seqlock around a snapshot living in memory shared between processes. A writer makes the
+// sequence odd while it changes the snapshot, readers copy it and retry when the sequence was odd
+// or moved meanwhile, so readers never block the writer. Writers take the odd sequence with a
+// compare and swap, so two of them never interleave, and only the latest claim may write: a
+// publisher claiming the segment displaces the previous one at its next write.
+struct PublishedState
+{
+  // How long a write stays odd before the writer holding it is checked for having died in it
+  static const int abandonedMs = 100;
+
+  // The count in the low half, while odd the pid of its writer in the high half
+  std::atomic<uint64_t> sequence;
+  std::atomic<uint64_t> writerCreated; // Creation time of that writer, 0 until it stored it
+  std::atomic<uint32_t> owner;         // The latest claim
+  PublishedSnapshot snapshot;
+
+  // Makes the caller the only writer, pass the result to write()
+  uint32_t claim()
+  {
+    return owner.fetch_add(1) + 1;
+  }
+
+  // `change` gets the snapshot to modify in place. False, and nothing changed, once another claim
+  // displaced `claimed`. `isAlive(pid, created)` tells whether a writer left odd is still running,
+  // only a dead one is taken over, since a live one may only be descheduled and go on writing.
+  template <typename IsAlive, typename Change>
+  bool write(uint32_t claimed, uint32_t pid, uint64_t created, IsAlive isAlive, Change change)
+  {
+    uint64_t previous = 0;
+    uint32_t start = lockSequence(pid, created, isAlive, previous);
+    if (owner.load(std::memory_order_relaxed) != claimed)
+    {
+      writerCreated.store(0, std::memory_order_relaxed);
+      sequence.store(previous, std::memory_order_release); // Back to the value before, nothing changed
+      return false;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    change(snapshot);
+    writerCreated.store(0, std::memory_order_relaxed);
+    sequence.store(start + 1, std::memory_order_release);
+    return true;
+  }
+
+  // False when nothing was published yet or the writer kept changing it for `attempts` copies
+  bool read(PublishedSnapshot& copy, int attempts = 1000) const
+  {
+    for (int attempt = 0; attempt < attempts; attempt++)
+    {
+      uint64_t before = sequence.load(std::memory_order_acquire);
+      if (before & 1)
+      {
+        continue;
+      }
+      std::memcpy(&copy, &snapshot, sizeof(copy));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence.load(std::memory_order_relaxed) == before)
+      {
+        return copy.magic == PublishedSnapshot::currentMagic;
+      }
+    }
+    return false;
+  }
+
+  uint32_t version() const
+  {
+    return static_cast<uint32_t>(sequence.load(std::memory_order_acquire)) / 2;
+  }
+
+private:
+  // Waits for other writers and returns the odd count taken, `previous` gets the sequence before
+  template <typename IsAlive>
+  uint32_t lockSequence(uint32_t pid, uint64_t created, IsAlive isAlive, uint64_t& previous)
+  {
+    auto oddSince = std::chrono::steady_clock::now();
+    uint64_t odd = 0;
+    for (;;)
+    {
+      uint64_t current = sequence.load(std::memory_order_relaxed);
+      uint32_t count = static_cast<uint32_t>(current);
+      if (!(count & 1))
+      {
+        if (take(current, count + 1, pid, created))
+        {
+          previous = current;
+          return count + 1;
+        }
+        continue;
+      }
+      if (current != odd)
+      {
+        odd = current;
+        oddSince = std::chrono::steady_clock::now();
+      }
+      else if (std::chrono::steady_clock::now() - oddSince > std::chrono::milliseconds(abandonedMs))
+      {
+        // Taken over by moving to the next odd count, readers keep retrying meanwhile. The creation
+        // time is cleared first, a taker stalled before storing its own is then checked by pid.
+        if (!isAlive(static_cast<uint32_t>(current >> 32), writerCreated.load(std::memory_order_relaxed)))
+        {
+          writerCreated.store(0, std::memory_order_relaxed);
+          if (take(current, count + 2, pid, created))
+          {
+            previous = current;
+            return count + 2;
+          }
+        }
+        oddSince = std::chrono::steady_clock::now();
+      }
+      std::this_thread::yield();
+    }
+  }
+
+  bool take(uint64_t current, uint32_t count, uint32_t pid, uint64_t created)
+  {
+    if (!sequence.compare_exchange_strong(current, (static_cast<uint64_t>(pid) << 32) | count, std::memory_order_acquire))
+    {
+      return false;
+    }
+    writerCreated.store(created, std::memory_order_relaxed);
+    return true;
+  }
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "The sequence is shared with other processes, it must be a plain lock free word");
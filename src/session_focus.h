@@ -0,0 +1,101 @@
+#pragma once
+#include <windows.h>
+#include <audiopolicy.h>
+#include <cwctype>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include <wrl/client.h>
+#include "lock_stats.h"
+#include "process_name_cache.h"
+
+inline std::wstring toLowerCase(std::wstring value)
+{
+  for (auto& character : value)
+  {
+    character = static_cast<wchar_t>(std::towlower(character));
+  }
+  return value;
+}
+
+// Registered with the session manager while focus mode is on. Sessions created in the meantime
+// are muted right in the notification unless they belong to a focused process, so nothing new
+// leaks through before JS gets to run. The sessions it muted are handed back on unfocus.
+class FocusSessionWatcher : public IAudioSessionNotification
+{
+public:
+  FocusSessionWatcher(std::unordered_set<DWORD> keptPids, std::unordered_set<std::wstring> keptNames)
+    : keptPids(std::move(keptPids)), keptNames(std::move(keptNames))
+  {
+  }
+
+  std::vector<Microsoft::WRL::ComPtr<ISimpleAudioVolume>> takeMutedSessions()
+  {
+    std::lock_guard<CountedMutex> lock(mutex);
+    return std::move(mutedSessions);
+  }
+
+  // IUnknown
+
+  ULONG STDMETHODCALLTYPE AddRef() override
+  {
+    return InterlockedIncrement(&references);
+  }
+
+  ULONG STDMETHODCALLTYPE Release() override
+  {
+    ULONG remaining = InterlockedDecrement(&references);
+    if (remaining == 0)
+    {
+      delete this;
+    }
+    return remaining;
+  }
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override
+  {
+    if (riid == __uuidof(IUnknown) || riid == __uuidof(IAudioSessionNotification))
+    {
+      *object = static_cast<IAudioSessionNotification*>(this);
+      AddRef();
+      return S_OK;
+    }
+    *object = NULL;
+    return E_NOINTERFACE;
+  }
+
+  // IAudioSessionNotification
+
+  HRESULT STDMETHODCALLTYPE OnSessionCreated(IAudioSessionControl* session) override
+  {
+    Microsoft::WRL::ComPtr<IAudioSessionControl2> control;
+    Microsoft::WRL::ComPtr<ISimpleAudioVolume> volume;
+    if (FAILED(session->QueryInterface(IID_PPV_ARGS(&control))) || FAILED(session->QueryInterface(IID_PPV_ARGS(&volume))))
+    {
+      return S_OK;
+    }
+
+    DWORD pid = 0;
+    control->GetProcessId(&pid);
+    if (keptPids.count(pid) != 0 || keptNames.count(toLowerCase(ProcessNameCache::shared().resolve(pid))) != 0)
+    {
+      return S_OK;
+    }
+
+    BOOL muted = FALSE;
+    if (SUCCEEDED(volume->GetMute(&muted)) && !muted && SUCCEEDED(volume->SetMute(TRUE, NULL)))
+    {
+      std::lock_guard<CountedMutex> lock(mutex);
+      mutedSessions.push_back(volume);
+    }
+    return S_OK;
+  }
+
+private:
+  LONG references = 1;
+  const std::unordered_set<DWORD> keptPids;
+  const std::unordered_set<std::wstring> keptNames; // Lower case executable names
+  CountedMutex mutex{LockSite::SessionFocus};
+  std::vector<Microsoft::WRL::ComPtr<ISimpleAudioVolume>> mutedSessions;
+};
@@ -0,0 +1,153 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Struct-of-arrays mirror of every session's state, indexed by the session handle's slot
+// index. Batch operations plan against it with branch-free passes over the columns, which the
+// compiler vectorizes, and return only the slots whose value actually changes.
+class SessionStateTable
+{
+public:
+  enum Flags : uint8_t
+  {
+    Live = 1,         // Slot holds a session
+    SystemSounds = 2, // The system sounds session
+  };
+
+  void set(uint32_t index, uint32_t handle, float volume, bool muted, uint8_t state, uint8_t flags)
+  {
+    if (index >= handles.size())
+    {
+      resize(index + 1);
+    }
+    handles[index] = handle;
+    volumes[index] = volume;
+    mutes[index] = muted ? 1 : 0;
+    states[index] = state;
+    sessionFlags[index] = flags | Live;
+  }
+
+  void setVolume(uint32_t index, float volume)
+  {
+    volumes[index] = volume;
+  }
+
+  void setMuted(uint32_t index, bool muted)
+  {
+    mutes[index] = muted ? 1 : 0;
+  }
+
+  void clear(uint32_t index)
+  {
+    if (index < handles.size())
+    {
+      handles[index] = 0;
+      sessionFlags[index] = 0;
+    }
+  }
+
+  size_t size() const
+  {
+    return handles.size();
+  }
+
+  const uint32_t* handleColumn() const { return handles.data(); }
+  const float* volumeColumn() const { return volumes.data(); }
+  const uint8_t* mutedColumn() const { return mutes.data(); }
+  const uint8_t* stateColumn() const { return states.data(); }
+  const uint8_t* flagColumn() const { return sessionFlags.data(); }
+
+  // Slots whose volume changes when every live session is scaled by `factor`, clamped to 0..1.
+  // The new volumes are written to `targets`, indexed like the slots.
+  void planScale(float factor, std::vector<float>& targets, std::vector<uint32_t>& changed) const
+  {
+    size_t count = volumes.size();
+    targets.resize(count);
+    const float* current = volumes.data();
+    float* target = targets.data();
+    for (size_t i = 0; i < count; i++)
+    {
+      target[i] = std::min(1.0f, std::max(0.0f, current[i] * factor));
+    }
+    collectChanged(targets.data(), current, changed);
+  }
+
+  // Slots whose mute state changes when all live sessions except `keepIndex` get `muted`.
+  // Pass an index past the end to apply to every session.
+  void planMuteExcept(uint32_t keepIndex, bool muted, std::vector<uint8_t>& targets, std::vector<uint32_t>& changed) const
+  {
+    size_t count = mutes.size();
+    targets.resize(count);
+    const uint8_t* current = mutes.data();
+    uint8_t* target = targets.data();
+    const uint8_t value = muted ? 1 : 0;
+    for (size_t i = 0; i < count; i++)
+    {
+      target[i] = value;
+    }
+    if (keepIndex < count)
+    {
+      target[keepIndex] = current[keepIndex];
+    }
+    collectChanged(targets.data(), current, changed);
+  }
+
+  // Same as planMuteExcept with any number of kept slots, `keep` is indexed like the slots
+  void planMuteExcept(const std::vector<uint8_t>& keep, bool muted, std::vector<uint8_t>& targets, std::vector<uint32_t>& changed) const
+  {
+    size_t count = mutes.size();
+    targets.resize(count);
+    const uint8_t* current = mutes.data();
+    const uint8_t* kept = keep.data();
+    uint8_t* target = targets.data();
+    const uint8_t value = muted ? 1 : 0;
+    for (size_t i = 0; i < count; i++)
+    {
+      target[i] = kept[i] ? current[i] : value;
+    }
+    collectChanged(targets.data(), current, changed);
+  }
+
+private:
+  std::vector<uint32_t> handles;
+  std::vector<float> volumes;
+  std::vector<uint8_t> mutes;
+  std::vector<uint8_t> states;
+  std::vector<uint8_t> sessionFlags;
+  mutable std::vector<uint8_t> differs;
+
+  void resize(size_t count)
+  {
+    handles.resize(count, 0);
+    volumes.resize(count, 0.0f);
+    mutes.resize(count, 0);
+    states.resize(count, 0);
+    sessionFlags.resize(count, 0);
+  }
+
+  template <typename T>
+  void collectChanged(const T* target, const T* current, std::vector<uint32_t>& changed) const
+  {
+    size_t count = sessionFlags.size();
+    differs.resize(count);
+    const uint8_t* flags = sessionFlags.data();
+    uint8_t* mask = differs.data();
+
+    // Branch-free compare pass, then a sparse gather of the few slots that differ
+    for (size_t i = 0; i < count; i++)
+    {
+      mask[i] = static_cast<uint8_t>((target[i] != current[i]) & (flags[i] & Live));
+    }
+
+    changed.clear();
+    for (size_t i = 0; i < count; i++)
+    {
+      if (mask[i])
+      {
+        changed.push_back(static_cast<uint32_t>(i));
+      }
+    }
+  }
+};
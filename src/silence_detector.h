@@ -0,0 +1,77 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+
+// Tells stretches of silence apart from short pauses. Silence starts once the level stayed at or
+// below the threshold for `holdMs` and ends with the first sample above it.
+class SilenceDetector
+{
+public:
+  struct Settings
+  {
+    float threshold = 0.001f; // -60 dBFS
+    uint64_t holdMs = 2000;
+    uint32_t maxIntervalMs = 1000; // Longest sampling interval the caller backs off to while silent
+  };
+
+  enum class Transition
+  {
+    None,
+    Started,
+    Ended,
+  };
+
+  explicit SilenceDetector(const Settings& settings) : settings(settings)
+  {
+  }
+
+  Transition update(uint64_t timeMs, float level)
+  {
+    if (level > settings.threshold)
+    {
+      bool wasSilent = silent;
+      quiet = false;
+      silent = false;
+      return wasSilent ? Transition::Ended : Transition::None;
+    }
+
+    if (!quiet)
+    {
+      quiet = true;
+      quietSince = timeMs;
+    }
+    if (!silent && timeMs - quietSince >= settings.holdMs)
+    {
+      silent = true;
+      return Transition::Started;
+    }
+    return Transition::None;
+  }
+
+  bool isSilent() const
+  {
+    return silent;
+  }
+
+  // Start of the current or, right after it ended, the latest stretch of silence, hold time included
+  uint64_t silentSince() const
+  {
+    return quietSince;
+  }
+
+  // Sampling interval doubling from `intervalMs` per sample while silent, up to the maximum
+  uint32_t interval(uint32_t intervalMs, uint32_t previousMs) const
+  {
+    if (!silent)
+    {
+      return intervalMs;
+    }
+    return std::max(intervalMs, std::min(settings.maxIntervalMs, previousMs * 2));
+  }
+
+private:
+  Settings settings;
+  bool quiet = false;
+  bool silent = false;
+  uint64_t quietSince = 0;
+};
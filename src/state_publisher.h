@@ -0,0 +1,224 @@
+#pragma once
+#include <windows.h>
+#include <mutex>
+#include <string>
+#include "check_errors.h"
+#include "clock.h"
+#include "lock_stats.h"
+#include "object_counts.h"
+#include "process_liveness.h"
+#include "published_state.h"
+
+// Name of the segment holding the published state of an endpoint, visible to the whole session
+inline std::wstring publishedStateName(const std::wstring& endpointId)
+{
+  return L"Local\\node-audio-windows." + endpointId;
+}
+
+// Writes device and session state into a named shared memory segment other processes map read
+// only. Does nothing until opened, so the notification handlers can call it unconditionally. One
+// publisher per segment: a second one takes the segment over, starting from an empty snapshot,
+// and the displaced one closes at its next write.
+class StatePublisher
+{
+public:
+  StatePublisher() = default;
+
+  ~StatePublisher()
+  {
+    close();
+  }
+
+  StatePublisher(const StatePublisher&) = delete;
+  StatePublisher& operator=(const StatePublisher&) = delete;
+
+  void open(const std::wstring& name)
+  {
+    std::lock_guard<CountedMutex> lock(mutex);
+    unmap();
+    mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(PublishedState), name.c_str());
+    if (mapping != NULL)
+    {
+      state = static_cast<PublishedState*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(PublishedState)));
+    }
+    if (state == NULL)
+    {
+      HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+      unmap();
+      checkErrors(hr, "creating the shared state segment");
+    }
+    claimed = state->claim();
+    writeState([](PublishedSnapshot& snapshot) {
+      snapshot = PublishedSnapshot();
+      snapshot.magic = PublishedSnapshot::currentMagic;
+      snapshot.publisherPid = GetCurrentProcessId();
+      snapshot.updated = unixTimeMs();
+    });
+  }
+
+  // Readers still mapping the segment keep the last state, it goes away with the last of them
+  void close()
+  {
+    std::lock_guard<CountedMutex> lock(mutex);
+    unmap();
+  }
+
+  bool isOpen() const
+  {
+    std::lock_guard<CountedMutex> lock(mutex);
+    return state != NULL;
+  }
+
+  void publishDevice(float volume, bool muted)
+  {
+    update([&](PublishedSnapshot& snapshot) {
+      snapshot.volume = volume;
+      snapshot.muted = muted ? 1 : 0;
+    });
+  }
+
+  // Slots past the segment's capacity are not published
+  void publishSession(uint32_t index, const PublishedSession& session)
+  {
+    if (index >= PublishedSnapshot::maxSessions)
+    {
+      return;
+    }
+    update([&](PublishedSnapshot& snapshot) {
+      snapshot.sessions[index] = session;
+      if (index >= snapshot.sessionCount)
+      {
+        snapshot.sessionCount = index + 1;
+      }
+    });
+  }
+
+  // Skipped when the slot holds another session by now
+  void publishSessionVolume(uint32_t index, uint32_t handle, float volume, bool muted)
+  {
+    if (index >= PublishedSnapshot::maxSessions)
+    {
+      return;
+    }
+    update([&](PublishedSnapshot& snapshot) {
+      PublishedSession& session = snapshot.sessions[index];
+      if (session.handle == handle)
+      {
+        session.volume = volume;
+        session.muted = muted ? 1 : 0;
+      }
+    });
+  }
+
+  void removeSession(uint32_t index)
+  {
+    if (index >= PublishedSnapshot::maxSessions)
+    {
+      return;
+    }
+    update([&](PublishedSnapshot& snapshot) {
+      snapshot.sessions[index] = PublishedSession();
+    });
+  }
+
+private:
+  mutable CountedMutex mutex{LockSite::StatePublisher}; // Notifications of the device and of every session arrive on different threads
+  HANDLE mapping = NULL;
+  PublishedState* state = NULL;
+  uint32_t claimed = 0;
+  uint64_t created = processCreated(GetCurrentProcess()); // Identifies this process as a writer
+
+  template <typename Change>
+  bool writeState(Change change)
+  {
+    return state->write(claimed, GetCurrentProcessId(), created, isProcessAlive, change);
+  }
+
+  template <typename Change>
+  void update(Change change)
+  {
+    std::lock_guard<CountedMutex> lock(mutex);
+    if (state == NULL)
+    {
+      return;
+    }
+    bool written = writeState([&](PublishedSnapshot& snapshot) {
+      change(snapshot);
+      snapshot.updated = unixTimeMs();
+    });
+    if (!written)
+    {
+      unmap();
+    }
+  }
+
+  void unmap()
+  {
+    if (state != NULL)
+    {
+      UnmapViewOfFile(state);
+      state = NULL;
+    }
+    if (mapping != NULL)
+    {
+      CloseHandle(mapping);
+      mapping = NULL;
+    }
+  }
+};
+
+// Read only view of a segment published by another process, or this one
+class PublishedStateReader
+{
+public:
+  // Throws when no process publishes under `name`
+  explicit PublishedStateReader(const std::wstring& name)
+  {
+    mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, name.c_str());
+    if (mapping != NULL)
+    {
+      state = static_cast<const PublishedState*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(PublishedState)));
+    }
+    if (state == NULL)
+    {
+      HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+      close();
+      checkErrors(hr, "opening the shared state segment");
+    }
+  }
+
+  ~PublishedStateReader()
+  {
+    close();
+  }
+
+  PublishedStateReader(const PublishedStateReader&) = delete;
+  PublishedStateReader& operator=(const PublishedStateReader&) = delete;
+
+  bool read(PublishedSnapshot& copy) const
+  {
+    return state->read(copy);
+  }
+
+  uint32_t version() const
+  {
+    return state->version();
+  }
+
+private:
+  HANDLE mapping = NULL;
+  const PublishedState* state = NULL;
+  ObjectCount<NativeObject::SharedStateReader> counted;
+
+  void close()
+  {
+    if (state != NULL)
+    {
+      UnmapViewOfFile(state);
+    }
+    if (mapping != NULL)
+    {
+      CloseHandle(mapping);
+    }
+  }
+};
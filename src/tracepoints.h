@@ -0,0 +1,111 @@
+#pragma once
+
+// Static tracepoints, compiled in when building with the gyp variable audio_tracepoints=1 and
+// expanding to nothing otherwise. They are TraceLogging events of the ETW provider
+// "NodeAudioWindows" (901b3fae-7916-5f85-5885-22f08a0f05c6, the GUID hashed from the name, so
+// tools accept "*NodeAudioWindows"):
+//
+//   Operation     start and stop of every VolumeControl operation, field `name`
+//   Notification  start and stop of every endpoint and session notification handler, field `kind`
+//   Enqueue       an event entering the queue: `type`, `target`, `queued` after it, `coalesced`
+//   Dequeue       events leaving the queue: `count`, `queued` after them
+//   Deliver       start and stop of handing drained events to JS
+//
+// Start and stop pairs share the thread, so the latency of an operation is the time between them.
+// While no session listens, a tracepoint is a test of the provider's enabled flag.
+#ifdef AUDIO_TRACEPOINTS
+#include <windows.h>
+#include <TraceLoggingProvider.h>
+#include <winmeta.h>
+
+TRACELOGGING_DECLARE_PROVIDER(audioTraceProvider);
+
+// In exactly one translation unit of each binary, which registers the provider while it runs
+#define AUDIO_TRACE_PROVIDER_DEFINITION()                    \
+  TRACELOGGING_DEFINE_PROVIDER(                              \
+    audioTraceProvider,                                      \
+    "NodeAudioWindows",                                      \
+    (0x901b3fae, 0x7916, 0x5f85, 0x58, 0x85, 0x22, 0xf0, 0x8a, 0x0f, 0x05, 0xc6))
+#define AUDIO_TRACE_REGISTER() TraceLoggingRegister(audioTraceProvider)
+#define AUDIO_TRACE_UNREGISTER() TraceLoggingUnregister(audioTraceProvider)
+
+class OperationTrace
+{
+public:
+  explicit OperationTrace(const char* name) : name(name)
+  {
+    TraceLoggingWrite(audioTraceProvider, "Operation", TraceLoggingOpcode(WINEVENT_OPCODE_START), TraceLoggingString(name, "name"));
+  }
+
+  ~OperationTrace()
+  {
+    TraceLoggingWrite(audioTraceProvider, "Operation", TraceLoggingOpcode(WINEVENT_OPCODE_STOP), TraceLoggingString(name, "name"));
+  }
+
+  OperationTrace(const OperationTrace&) = delete;
+  OperationTrace& operator=(const OperationTrace&) = delete;
+
+private:
+  const char* name;
+};
+
+class NotificationTrace
+{
+public:
+  explicit NotificationTrace(const char* kind) : kind(kind)
+  {
+    TraceLoggingWrite(audioTraceProvider, "Notification", TraceLoggingOpcode(WINEVENT_OPCODE_START), TraceLoggingString(kind, "kind"));
+  }
+
+  ~NotificationTrace()
+  {
+    TraceLoggingWrite(audioTraceProvider, "Notification", TraceLoggingOpcode(WINEVENT_OPCODE_STOP), TraceLoggingString(kind, "kind"));
+  }
+
+  NotificationTrace(const NotificationTrace&) = delete;
+  NotificationTrace& operator=(const NotificationTrace&) = delete;
+
+private:
+  const char* kind;
+};
+
+class DeliverTrace
+{
+public:
+  DeliverTrace()
+  {
+    TraceLoggingWrite(audioTraceProvider, "Deliver", TraceLoggingOpcode(WINEVENT_OPCODE_START));
+  }
+
+  ~DeliverTrace()
+  {
+    TraceLoggingWrite(audioTraceProvider, "Deliver", TraceLoggingOpcode(WINEVENT_OPCODE_STOP));
+  }
+
+  DeliverTrace(const DeliverTrace&) = delete;
+  DeliverTrace& operator=(const DeliverTrace&) = delete;
+};
+
+#define AUDIO_TRACE_SCOPE(name) OperationTrace operationTrace(name)
+#define AUDIO_TRACE_NOTIFICATION(kind) NotificationTrace notificationTrace(kind)
+#define AUDIO_TRACE_DELIVER() DeliverTrace deliverTrace
+#define AUDIO_TRACE_ENQUEUE(type, target, queued, coalesced) \
+  TraceLoggingWrite(                                         \
+    audioTraceProvider,                                      \
+    "Enqueue",                                               \
+    TraceLoggingUInt8(static_cast<uint8_t>(type), "type"),   \
+    TraceLoggingUInt32(target, "target"),                    \
+    TraceLoggingUInt64(queued, "queued"),                    \
+    TraceLoggingBool(coalesced, "coalesced"))
+#define AUDIO_TRACE_DEQUEUE(count, queued) \
+  TraceLoggingWrite(audioTraceProvider, "Dequeue", TraceLoggingUInt64(count, "count"), TraceLoggingUInt64(queued, "queued"))
+#else
+#define AUDIO_TRACE_PROVIDER_DEFINITION() static_assert(true, "tracepoints are compiled out")
+#define AUDIO_TRACE_REGISTER() ((void)0)
+#define AUDIO_TRACE_UNREGISTER() ((void)0)
+#define AUDIO_TRACE_SCOPE(name) ((void)0)
+#define AUDIO_TRACE_NOTIFICATION(kind) ((void)0)
+#define AUDIO_TRACE_DELIVER() ((void)0)
+#define AUDIO_TRACE_ENQUEUE(type, target, queued, coalesced) ((void)0)
+#define AUDIO_TRACE_DEQUEUE(count, queued) ((void)0)
+#endif
@@ -0,0 +1,171 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define UTF16_TRANSCODER_SSE2 1
+#endif
+
+struct Utf16View
+{
+  const uint16_t* text;
+  size_t length;
+};
+
+// Where one transcoded string landed in the shared output buffer
+struct TranscodedSpan
+{
+  size_t offset;
+  size_t length;
+  bool latin1; // Latin-1 bytes if true, UTF-8 otherwise
+};
+
+// Number of leading code units below 0x100, i.e. how much of the text narrows to Latin-1 as is
+inline size_t latin1Prefix(const uint16_t* text, size_t length)
+{
+  size_t i = 0;
+#ifdef UTF16_TRANSCODER_SSE2
+  const __m128i highByte = _mm_set1_epi16(static_cast<short>(0xFF00));
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 8 <= length; i += 8)
+  {
+    __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+    __m128i wide = _mm_cmpeq_epi16(_mm_and_si128(units, highByte), zero);
+    if (_mm_movemask_epi8(wide) != 0xFFFF)
+    {
+      break;
+    }
+  }
+#endif
+  while (i < length && text[i] < 0x100)
+  {
+    i++;
+  }
+  return i;
+}
+
+// Narrows code units known to be below 0x100, writes exactly `length` bytes
+inline void narrowLatin1(const uint16_t* text, size_t length, char* out)
+{
+  size_t i = 0;
+#ifdef UTF16_TRANSCODER_SSE2
+  for (; i + 16 <= length; i += 16)
+  {
+    __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+    __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + 8));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(low, high));
+  }
+  if (i + 8 <= length)
+  {
+    __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(units, units));
+    i += 8;
+  }
+#endif
+  for (; i < length; i++)
+  {
+    out[i] = static_cast<char>(text[i]);
+  }
+}
+
+// Encodes UTF-16 as UTF-8, replacing unpaired surrogates with U+FFFD. `out` needs room for
+// 3 bytes per code unit. Returns the number of bytes written.
+inline size_t encodeUtf8(const uint16_t* text, size_t length, char* out)
+{
+  char* start = out;
+  size_t i = 0;
+  while (i < length)
+  {
+#ifdef UTF16_TRANSCODER_SSE2
+    // Runs of ASCII are packed 8 units at a time
+    const __m128i nonAscii = _mm_set1_epi16(static_cast<short>(0xFF80));
+    const __m128i zero = _mm_setzero_si128();
+    while (i + 8 <= length)
+    {
+      __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+      if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, nonAscii), zero)) != 0xFFFF)
+      {
+        break;
+      }
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(units, units));
+      out += 8;
+      i += 8;
+    }
+    if (i >= length)
+    {
+      break;
+    }
+#endif
+    uint32_t codePoint = text[i++];
+    if (codePoint >= 0xD800 && codePoint <= 0xDFFF)
+    {
+      if (codePoint <= 0xDBFF && i < length && text[i] >= 0xDC00 && text[i] <= 0xDFFF)
+      {
+        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (text[i++] - 0xDC00);
+      }
+      else
+      {
+        codePoint = 0xFFFD;
+      }
+    }
+
+    if (codePoint < 0x80)
+    {
+      *out++ = static_cast<char>(codePoint);
+    }
+    else if (codePoint < 0x800)
+    {
+      *out++ = static_cast<char>(0xC0 | (codePoint >> 6));
+      *out++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else if (codePoint < 0x10000)
+    {
+      *out++ = static_cast<char>(0xE0 | (codePoint >> 12));
+      *out++ = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+      *out++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else
+    {
+      *out++ = static_cast<char>(0xF0 | (codePoint >> 18));
+      *out++ = static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+      *out++ = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+      *out++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+  }
+  return out - start;
+}
+
+// Transcodes a whole batch into one buffer, sized once up front. Strings that fit Latin-1 are
+// narrowed (V8 stores them one byte per character anyway), the rest are encoded as UTF-8.
+inline void transcodeAll(const Utf16View* views, size_t count, std::vector<char>& bytes, std::vector<TranscodedSpan>& spans)
+{
+  size_t capacity = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    capacity += views[i].length * 3; // A surrogate pair is 2 units for 4 bytes, so 3 bytes per unit covers everything
+  }
+  bytes.resize(capacity);
+  spans.resize(count);
+
+  size_t offset = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    const Utf16View& view = views[i];
+    TranscodedSpan& span = spans[i];
+    span.offset = offset;
+    span.latin1 = latin1Prefix(view.text, view.length) == view.length;
+    if (span.latin1)
+    {
+      narrowLatin1(view.text, view.length, bytes.data() + offset);
+      span.length = view.length;
+    }
+    else
+    {
+      span.length = encodeUtf8(view.text, view.length, bytes.data() + offset);
+    }
+    offset += span.length;
+  }
+  bytes.resize(offset);
+}
@@ -0,0 +1,210 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Voice activity on mono capture blocks from frame energy and spectral flatness. A frame of about
+// 20 ms counts as speech when it is well above the tracked noise floor and its spectrum in the
+// speech band is tonal rather than flat, so steady fans and hiss stay out. Speech starts after
+// `attackMs` of speech frames and stops after `releaseMs` without one.
+class VoiceActivityDetector
+{
+public:
+  struct Settings
+  {
+    double marginDb = 9.0;     // Above the noise floor
+    double minimumDb = -55.0;  // Frames quieter than this never count as speech
+    double flatness = 0.35;    // Speech band flatness below which a frame is tonal
+    uint32_t attackMs = 60;
+    uint32_t releaseMs = 400;
+  };
+
+  enum class Transition
+  {
+    None,
+    Started,
+    Stopped,
+  };
+
+  VoiceActivityDetector(const Settings& settings, uint32_t sampleRate)
+    : settings(settings), sampleRate(sampleRate)
+  {
+    size = 64;
+    while (size < sampleRate / 50)
+    {
+      size *= 2;
+    }
+    frame.reserve(size);
+    spectrum.resize(size);
+    window.resize(size);
+    twiddles.resize(size / 2);
+    const double pi = 3.14159265358979323846;
+    for (size_t i = 0; i < size; i++)
+    {
+      window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * pi * i / size));
+    }
+    for (size_t i = 0; i < size / 2; i++)
+    {
+      twiddles[i] = std::polar(1.0f, static_cast<float>(-2.0 * pi * i / size));
+    }
+    lowBin = std::max<size_t>(1, static_cast<size_t>(std::ceil(250.0 * size / sampleRate)));
+    highBin = std::min<size_t>(size / 2, static_cast<size_t>(4000.0 * size / sampleRate));
+  }
+
+  // Feeds mono samples, `timeMs` is the capture time of the first one. Returns the transition of
+  // the last frame completed, a block spanning several frames reports at most one.
+  Transition process(const float* samples, size_t count, uint64_t timeMs)
+  {
+    Transition result = Transition::None;
+    for (size_t i = 0; i < count; i++)
+    {
+      frame.push_back(samples[i]);
+      if (frame.size() == size)
+      {
+        uint64_t frameEnd = timeMs + (i + 1) * 1000 / sampleRate;
+        Transition transition = update(analyze(), frameEnd);
+        if (transition != Transition::None)
+        {
+          result = transition;
+        }
+        frame.clear();
+      }
+    }
+    return result;
+  }
+
+  bool isSpeaking() const
+  {
+    return speaking;
+  }
+
+  // Time of the frame that made the latest transition
+  uint64_t transitionTime() const
+  {
+    return lastTransition;
+  }
+
+  double noiseFloorDb() const
+  {
+    return noiseFloor;
+  }
+
+private:
+  Settings settings;
+  uint32_t sampleRate;
+  size_t size; // Samples per frame, a power of two
+  size_t lowBin;
+  size_t highBin;
+  std::vector<float> frame;
+  std::vector<float> window;
+  std::vector<std::complex<float>> spectrum;
+  std::vector<std::complex<float>> twiddles;
+  double noiseFloor = 0.0;
+  bool floorKnown = false;
+  bool speaking = false;
+  uint32_t speechRunMs = 0;
+  uint32_t quietRunMs = 0;
+  uint64_t lastTransition = 0;
+
+  bool analyze()
+  {
+    double energy = 0.0;
+    for (size_t i = 0; i < size; i++)
+    {
+      energy += static_cast<double>(frame[i]) * frame[i];
+      spectrum[i] = std::complex<float>(frame[i] * window[i], 0.0f);
+    }
+    double levelDb = 10.0 * std::log10(energy / size + 1e-12);
+
+    if (!floorKnown)
+    {
+      noiseFloor = levelDb;
+      floorKnown = true;
+    }
+    bool loud = levelDb > noiseFloor + settings.marginDb && levelDb > settings.minimumDb;
+    bool speech = loud && flatness() < settings.flatness;
+
+    // The floor drops at once and creeps up slowly, so speech does not drag it along
+    if (levelDb < noiseFloor)
+    {
+      noiseFloor = levelDb;
+    }
+    else if (!speech)
+    {
+      noiseFloor += (levelDb - noiseFloor) * 0.05;
+    }
+    return speech;
+  }
+
+  // Geometric over arithmetic mean of the power spectrum in the speech band, 1 for white noise
+  // and close to 0 for voiced sounds
+  double flatness()
+  {
+    transform();
+    double logSum = 0.0;
+    double sum = 0.0;
+    for (size_t bin = lowBin; bin < highBin; bin++)
+    {
+      double power = std::norm(spectrum[bin]) + 1e-12;
+      logSum += std::log(power);
+      sum += power;
+    }
+    size_t bins = highBin - lowBin;
+    return std::exp(logSum / bins) / (sum / bins);
+  }
+
+  // In place iterative radix-2 FFT
+  void transform()
+  {
+    for (size_t i = 1, j = 0; i < size; i++)
+    {
+      size_t bit = size >> 1;
+      for (; j & bit; bit >>= 1)
+      {
+        j ^= bit;
+      }
+      j ^= bit;
+      if (i < j)
+      {
+        std::swap(spectrum[i], spectrum[j]);
+      }
+    }
+    for (size_t length = 2; length <= size; length *= 2)
+    {
+      size_t stride = size / length;
+      for (size_t start = 0; start < size; start += length)
+      {
+        for (size_t k = 0; k < length / 2; k++)
+        {
+          std::complex<float> odd = spectrum[start + k + length / 2] * twiddles[k * stride];
+          spectrum[start + k + length / 2] = spectrum[start + k] - odd;
+          spectrum[start + k] += odd;
+        }
+      }
+    }
+  }
+
+  Transition update(bool speech, uint64_t timeMs)
+  {
+    uint32_t frameMs = static_cast<uint32_t>(size * 1000 / sampleRate);
+    speechRunMs = speech ? speechRunMs + frameMs : 0;
+    quietRunMs = speech ? 0 : quietRunMs + frameMs;
+
+    if (!speaking && speechRunMs >= settings.attackMs)
+    {
+      speaking = true;
+      lastTransition = timeMs;
+      return Transition::Started;
+    }
+    if (speaking && quietRunMs >= settings.releaseMs)
+    {
+      speaking = false;
+      lastTransition = timeMs;
+      return Transition::Stopped;
+    }
+    return Transition::None;
+  }
+};
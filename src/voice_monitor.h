@@ -0,0 +1,290 @@
+#pragma once
+#include <windows.h>
+#include <mmdeviceapi.h>
+#include <mmreg.h>
+#include <audioclient.h>
+#include <endpointvolume.h>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <wrl/client.h>
+#include "check_errors.h"
+#include "clock.h"
+#include "event_queue.h"
+#include "object_counts.h"
+#include "voice_activity.h"
+
+// Captures a microphone in shared mode on its own thread and runs the voice activity detector
+// over every packet, raising voiceStart/voiceStop events. With `autoMute` the thread mutes the
+// endpoint itself as soon as speech stops, without a round trip through JS. Unmuting is left to
+// the caller: a muted microphone captures silence, so speech could never unmute it.
+class VoiceActivityMonitor
+{
+public:
+  VoiceActivityMonitor(const std::wstring& deviceId, const VoiceActivityDetector::Settings& settings, bool autoMute, std::shared_ptr<EventQueue> events)
+    : deviceId(deviceId), settings(settings), autoMute(autoMute), events(std::move(events))
+  {
+    stopEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    readyEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+
+    std::promise<HRESULT> started;
+    std::future<HRESULT> result = started.get_future();
+    thread = std::thread(&VoiceActivityMonitor::run, this, std::move(started));
+
+    HRESULT hr = result.get();
+    if (FAILED(hr))
+    {
+      thread.join();
+      CloseHandle(stopEvent);
+      CloseHandle(readyEvent);
+      checkErrors(hr, "Error when trying to capture from the microphone");
+    }
+  }
+
+  ~VoiceActivityMonitor()
+  {
+    SetEvent(stopEvent);
+    thread.join();
+    CloseHandle(stopEvent);
+    CloseHandle(readyEvent);
+  }
+
+  VoiceActivityMonitor(const VoiceActivityMonitor&) = delete;
+  VoiceActivityMonitor& operator=(const VoiceActivityMonitor&) = delete;
+
+  bool isSpeaking() const
+  {
+    return speaking;
+  }
+
+private:
+  std::wstring deviceId;
+  VoiceActivityDetector::Settings settings;
+  bool autoMute;
+  std::shared_ptr<EventQueue> events;
+  HANDLE stopEvent;
+  HANDLE readyEvent; // Signaled by the audio engine when a packet is ready
+  std::thread thread;
+  std::atomic<bool> speaking{false};
+  ObjectCount<NativeObject::VoiceActivityMonitor> counted;
+
+  enum class SampleFormat
+  {
+    Float32,
+    Int16,
+    Int32,
+  };
+
+  struct Capture
+  {
+    Microsoft::WRL::ComPtr<IAudioClient> client;
+    Microsoft::WRL::ComPtr<IAudioCaptureClient> capture;
+    Microsoft::WRL::ComPtr<IAudioEndpointVolume> volume;
+    SampleFormat format = SampleFormat::Float32;
+    uint32_t channels = 0;
+    uint32_t sampleRate = 0;
+  };
+
+  void run(std::promise<HRESULT> started)
+  {
+    CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    {
+      Capture capture;
+      HRESULT hr = open(capture);
+      if (SUCCEEDED(hr))
+      {
+        hr = capture.client->Start();
+      }
+      started.set_value(hr);
+
+      if (SUCCEEDED(hr))
+      {
+        VoiceActivityDetector detector(settings, capture.sampleRate);
+        std::vector<float> mono;
+        HANDLE waits[] = {stopEvent, readyEvent};
+        DWORD woken;
+        while ((woken = WaitForMultipleObjects(2, waits, FALSE, 2000)) != WAIT_OBJECT_0 && woken != WAIT_FAILED)
+        {
+          if (FAILED(drain(capture, detector, mono)))
+          {
+            // The device went away, the monitor stays silent until restarted. Speech in progress
+            // ends here, or isSpeaking() would report it forever.
+            if (speaking)
+            {
+              uint64_t now = unixTimeMs();
+              stopSpeaking(capture, now, now);
+            }
+            break;
+          }
+        }
+        capture.client->Stop();
+      }
+    }
+    CoUninitialize();
+  }
+
+  HRESULT open(Capture& capture)
+  {
+    Microsoft::WRL::ComPtr<IMMDeviceEnumerator> enumerator;
+    Microsoft::WRL::ComPtr<IMMDevice> device;
+    Microsoft::WRL::ComPtr<IMMEndpoint> endpoint;
+    EDataFlow flow = eRender;
+    HRESULT hr = CoCreateInstance(__uuidof(MMDeviceEnumerator), NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&enumerator));
+    if (SUCCEEDED(hr))
+    {
+      hr = enumerator->GetDevice(deviceId.c_str(), &device);
+    }
+    if (SUCCEEDED(hr))
+    {
+      hr = device.As(&endpoint);
+    }
+    if (SUCCEEDED(hr))
+    {
+      hr = endpoint->GetDataFlow(&flow);
+    }
+    if (SUCCEEDED(hr) && flow != eCapture)
+    {
+      hr = E_INVALIDARG; // Voice activity only makes sense on a microphone
+    }
+    if (SUCCEEDED(hr))
+    {
+      hr = device->Activate(__uuidof(IAudioClient), CLSCTX_INPROC_SERVER, NULL, &capture.client);
+    }
+    if (SUCCEEDED(hr))
+    {
+      hr = device->Activate(__uuidof(IAudioEndpointVolume), CLSCTX_INPROC_SERVER, NULL, &capture.volume);
+    }
+
+    WAVEFORMATEX* format = NULL;
+    if (SUCCEEDED(hr))
+    {
+      hr = capture.client->GetMixFormat(&format);
+    }
+    if (SUCCEEDED(hr))
+    {
+      WORD tag = format->wFormatTag;
+      if (tag == WAVE_FORMAT_EXTENSIBLE)
+      {
+        tag = static_cast<WORD>(reinterpret_cast<WAVEFORMATEXTENSIBLE*>(format)->SubFormat.Data1);
+      }
+      if (tag == WAVE_FORMAT_IEEE_FLOAT && format->wBitsPerSample == 32)
+      {
+        capture.format = SampleFormat::Float32;
+      }
+      else if (tag == WAVE_FORMAT_PCM && format->wBitsPerSample == 16)
+      {
+        capture.format = SampleFormat::Int16;
+      }
+      else if (tag == WAVE_FORMAT_PCM && format->wBitsPerSample == 32)
+      {
+        capture.format = SampleFormat::Int32;
+      }
+      else
+      {
+        hr = AUDCLNT_E_UNSUPPORTED_FORMAT;
+      }
+      capture.channels = format->nChannels;
+      capture.sampleRate = format->nSamplesPerSec;
+    }
+    if (SUCCEEDED(hr))
+    {
+      // 20 ms buffer, the engine signals every packet
+      hr = capture.client->Initialize(AUDCLNT_SHAREMODE_SHARED, AUDCLNT_STREAMFLAGS_EVENTCALLBACK, 200000, 0, format, NULL);
+    }
+    CoTaskMemFree(format);
+    if (SUCCEEDED(hr))
+    {
+      hr = capture.client->SetEventHandle(readyEvent);
+    }
+    if (SUCCEEDED(hr))
+    {
+      hr = capture.client->GetService(IID_PPV_ARGS(&capture.capture));
+    }
+    return hr;
+  }
+
+  HRESULT drain(Capture& capture, VoiceActivityDetector& detector, std::vector<float>& mono)
+  {
+    UINT32 packet = 0;
+    HRESULT hr = capture.capture->GetNextPacketSize(&packet);
+    while (SUCCEEDED(hr) && packet > 0)
+    {
+      BYTE* data = NULL;
+      UINT32 frames = 0;
+      DWORD flags = 0;
+      UINT64 position = 0;
+      hr = capture.capture->GetBuffer(&data, &frames, &flags, NULL, &position);
+      if (FAILED(hr))
+      {
+        break;
+      }
+      downmix(capture, (flags & AUDCLNT_BUFFERFLAGS_SILENT) ? NULL : data, frames, mono);
+      capture.capture->ReleaseBuffer(frames);
+
+      // Frames are timed from when the packet was captured, a packet drained later would otherwise
+      // date a transition late by its duration
+      uint64_t now = unixTimeMs();
+      bool stamped = position != 0 && !(flags & AUDCLNT_BUFFERFLAGS_TIMESTAMP_ERROR);
+      uint64_t captured = stamped ? unixTimeOfCounter(position) : now;
+      switch (detector.process(mono.data(), mono.size(), captured))
+      {
+        case VoiceActivityDetector::Transition::Started:
+          speaking = true;
+          events->push(AudioEvent{AudioEventType::VoiceStarted, now, 0, static_cast<double>(detector.transitionTime()), 0});
+          break;
+        case VoiceActivityDetector::Transition::Stopped:
+          stopSpeaking(capture, now, detector.transitionTime());
+          break;
+        default:
+          break;
+      }
+      hr = capture.capture->GetNextPacketSize(&packet);
+    }
+    return hr;
+  }
+
+  void stopSpeaking(Capture& capture, uint64_t now, uint64_t stoppedAt)
+  {
+    speaking = false;
+    if (autoMute)
+    {
+      capture.volume->SetMute(TRUE, NULL);
+    }
+    events->push(AudioEvent{AudioEventType::VoiceStopped, now, 0, static_cast<double>(stoppedAt), 0});
+  }
+
+  // Averages the channels of a packet, NULL for a packet flagged silent
+  static void downmix(const Capture& capture, const BYTE* data, UINT32 frames, std::vector<float>& mono)
+  {
+    mono.assign(frames, 0.0f);
+    if (data == NULL)
+    {
+      return;
+    }
+    float scale = 1.0f / capture.channels;
+    for (UINT32 frame = 0; frame < frames; frame++)
+    {
+      float sum = 0.0f;
+      for (uint32_t channel = 0; channel < capture.channels; channel++)
+      {
+        size_t index = frame * capture.channels + channel;
+        switch (capture.format)
+        {
+          case SampleFormat::Float32:
+            sum += reinterpret_cast<const float*>(data)[index];
+            break;
+          case SampleFormat::Int16:
+            sum += reinterpret_cast<const int16_t*>(data)[index] / 32768.0f;
+            break;
+          case SampleFormat::Int32:
+            sum += reinterpret_cast<const int32_t*>(data)[index] / 2147483648.0f;
+            break;
+        }
+      }
+      mono[frame] = sum * scale;
+    }
+  }
+};
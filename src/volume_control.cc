@@ -0,0 +1,9 @@
+#include "volume_control.h"
+
+// The policy combinations in use, compiled once for every binary linking this file. The header
+// declares them extern, so the translation units using them do not instantiate them again.
+template class BasicVolumeControl<NoInstrumentation, NoLocking, UncachedEndpoint>;
+template class BasicVolumeControl<CallCounters, NoLocking, UncachedEndpoint>;
+template class BasicVolumeControl<NoInstrumentation, NoLocking, NotifiedEndpointCache>;
+template class BasicVolumeControl<CallCounters, NoLocking, NotifiedEndpointCache>;
+template class BasicVolumeControl<NoInstrumentation, MutexLocking, UncachedEndpoint>;
@@ -0,0 +1,989 @@
+#pragma once
+#include <windows.h>
+#include <mmdeviceapi.h>
+#include <endpointvolume.h>
+#include <audiopolicy.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include <wrl/client.h>
+#include "check_errors.h"
+#include "clock.h"
+#include "control_policies.h"
+#include "endpoint_lease.h"
+#include "event_queue.h"
+#include "exposure_dose.h"
+#include "handle_table.h"
+#include "mapped_record.h"
+#include "meter_sampler.h"
+#include "mixer_journal.h"
+#include "object_counts.h"
+#include "process_name_cache.h"
+#include "session_focus.h"
+#include "session_state_table.h"
+#include "silence_detector.h"
+#include "state_publisher.h"
+#include "tracepoints.h"
+#include "volume_history.h"
+#include "voice_monitor.h"
+#include "volume_listeners.h"
+
+struct AudioSession
+{
+  uint32_t handle;
+  std::wstring id;   // Session instance identifier, unique per session
+  DWORD pid;
+  std::wstring name; // Executable name of the owning process, empty for the system sounds session
+  float volume;
+  BOOL muted;
+  AudioSessionState state;
+  bool systemSounds;
+};
+
+// The controller of one endpoint, with compile time policies for what runs around its operations:
+// the Instrumentation of the endpoint and session calls, the Locking of every operation and the
+// Cache answering volume and mute reads. See control_policies.h, the combinations in use are
+// instantiated once in volume_control.cc.
+template <typename Instrumentation, typename Locking, typename Cache>
+class BasicVolumeControl
+{
+private:
+  struct SessionSlot
+  {
+    Microsoft::WRL::ComPtr<IAudioSessionControl2> control;
+    Microsoft::WRL::ComPtr<ISimpleAudioVolume> volume;
+    Microsoft::WRL::ComPtr<SessionEventsListener> events;
+  };
+
+  // History series of the endpoint itself, sessions use their handle which is never 0
+  static const uint32_t deviceSeries = 0;
+
+  Microsoft::WRL::ComPtr<IMMDevice> endpoint;
+  Microsoft::WRL::ComPtr<IAudioEndpointVolume> device;
+  Microsoft::WRL::ComPtr<IAudioSessionManager2> manager;
+  HandleTable<SessionSlot> sessionHandles;
+  SessionStateTable sessionStates;
+  ObjectCount<NativeObject::VolumeControl> counted;
+
+  mutable Locking locking;
+  Instrumentation instrumentation;
+  Cache cache;
+
+  MixerJournal journal;
+  VolumeHistory history;
+  Microsoft::WRL::ComPtr<EndpointVolumeListener> volumeListener;
+
+  // Shared memory copy of the state for other processes, idle until publishing starts
+  StatePublisher publisher;
+
+  // Focus mode: the sessions focus() muted and the watcher muting sessions created since
+  std::vector<uint32_t> focusMuted;
+  Microsoft::WRL::ComPtr<FocusSessionWatcher> focusWatcher;
+
+  // Events raised on native threads, delivered to JS by the wrapper
+  std::shared_ptr<EventQueue> eventQueue = std::make_shared<EventQueue>();
+
+  // Arbitration with other processes writing the same endpoint, none until joined
+  std::unique_ptr<EndpointLease> lease;
+
+  // Exposure dose fed by the meter, its file keeps it across restarts
+  std::shared_ptr<ExposureDose> exposure;
+
+  bool silenceDetection = false;
+  SilenceDetector::Settings silenceSettings;
+
+  // Peak meter sampling and voice activity, declared last so their threads stop before anything
+  // else is released
+  std::unique_ptr<MeterSampler> meter;
+  std::unique_ptr<VoiceActivityMonitor> voice;
+
+  IAudioSessionManager2* sessionManager()
+  {
+    if (!manager)
+    {
+      checkErrors(
+        endpoint->Activate(__uuidof(IAudioSessionManager2), CLSCTX_INPROC_SERVER, NULL, &manager),
+        "activating the audio session manager");
+    }
+    return manager.Get();
+  }
+
+  ISimpleAudioVolume* sessionVolume(uint32_t handle)
+  {
+    SessionSlot* slot = sessionHandles.get(handle);
+    if (!slot)
+    {
+      throw string_format("Unknown or expired audio session handle %u", handle);
+    }
+    return slot->volume.Get();
+  }
+
+  // Raw session writes keeping the state table current, the public setters add journaling on top
+  void writeSessionVolume(uint32_t session, float volume)
+  {
+    checkErrors(sessionVolume(session)->SetMasterVolume(volume, NULL), "setting audio session volume");
+    sessionStates.setVolume(HandleTable<SessionSlot>::indexOf(session), volume);
+  }
+
+  void writeSessionMuted(uint32_t session, BOOL muted)
+  {
+    checkErrors(sessionVolume(session)->SetMute(muted, NULL), "setting audio session mute");
+    sessionStates.setMuted(HandleTable<SessionSlot>::indexOf(session), muted != FALSE);
+  }
+
+  // Device writes are refused while another process owns the control, failing with leaseConflict
+  void checkLease(LeaseControl control)
+  {
+    if (lease && !lease->holds(control))
+    {
+      throw HResultError(
+        control == LeaseControl::Volume ? "Another process holds the volume lease." : "Another process holds the mute lease.",
+        leaseConflict);
+    }
+  }
+
+  // Writes one side of a journal step back, skipping sessions that have ended since. A lease
+  // refusing any control of the step refuses it before anything is written.
+  size_t replay(const std::vector<JournalRecord>& step, bool undoing)
+  {
+    for (const JournalRecord& record : step)
+    {
+      if (record.control == MixerControl::DeviceVolume)
+      {
+        checkLease(LeaseControl::Volume);
+      }
+      else if (record.control == MixerControl::DeviceMute)
+      {
+        checkLease(LeaseControl::Mute);
+      }
+    }
+
+    size_t writes = 0;
+    for (const JournalRecord& record : step)
+    {
+      float value = undoing ? record.before : record.after;
+      switch (record.control)
+      {
+        case MixerControl::DeviceVolume:
+          checkErrors(device->SetMasterVolumeLevelScalar(value, NULL), "setting volume");
+          cache.storeVolume(value);
+          break;
+        case MixerControl::DeviceMute:
+          checkErrors(device->SetMute(value != 0, NULL), "setting mute");
+          cache.storeMuted(value != 0);
+          break;
+        case MixerControl::SessionVolume:
+          if (!sessionHandles.contains(record.target))
+          {
+            continue;
+          }
+          writeSessionVolume(record.target, value);
+          break;
+        case MixerControl::SessionMute:
+          if (!sessionHandles.contains(record.target))
+          {
+            continue;
+          }
+          writeSessionMuted(record.target, value != 0);
+          break;
+      }
+      writes++;
+    }
+    return writes;
+  }
+
+  // Reads behind the public getters, without their guard and call counting so the operations
+  // reading state internally are not counted as calls they did not receive
+  BOOL readMuted()
+  {
+    BOOL muted = false;
+    if (cache.muted(muted))
+    {
+      return muted;
+    }
+
+    checkErrors(device->GetMute(&muted), "getting muted state");
+
+    cache.fillMuted(muted);
+    return muted;
+  }
+
+  float readVolume()
+  {
+    float currentVolume = 0;
+    if (cache.volume(currentVolume))
+    {
+      return currentVolume;
+    }
+
+    checkErrors(
+      device->GetMasterVolumeLevelScalar(&currentVolume),
+      "getting volume");
+
+    cache.fillVolume(currentVolume);
+    return currentVolume;
+  }
+
+  std::vector<AudioSession> listSessions()
+  {
+    Microsoft::WRL::ComPtr<IAudioSessionEnumerator> sessionEnumerator;
+    checkErrors(sessionManager()->GetSessionEnumerator(&sessionEnumerator), "enumerating audio sessions");
+
+    int count = 0;
+    checkErrors(sessionEnumerator->GetCount(&count), "counting audio sessions");
+
+    std::vector<AudioSession> sessions;
+    std::vector<DWORD> pids;
+    std::unordered_set<uint32_t> present;
+    sessions.reserve(count);
+    pids.reserve(count);
+
+    for (int i = 0; i < count; i++)
+    {
+      Microsoft::WRL::ComPtr<IAudioSessionControl> control;
+      Microsoft::WRL::ComPtr<IAudioSessionControl2> control2;
+      Microsoft::WRL::ComPtr<ISimpleAudioVolume> sessionVolume;
+      checkErrors(sessionEnumerator->GetSession(i, &control), "getting audio session");
+      checkErrors(control.As(&control2), "getting audio session details");
+      checkErrors(control.As(&sessionVolume), "getting audio session volume");
+
+      AudioSession session = {};
+      LPWSTR instanceId = NULL;
+      checkErrors(control2->GetSessionInstanceIdentifier(&instanceId), "getting audio session id");
+      session.id = instanceId;
+      CoTaskMemFree(instanceId);
+
+      bool created = false;
+      session.handle = sessionHandles.acquire(session.id, &created);
+      if (created)
+      {
+        SessionSlot* slot = sessionHandles.get(session.handle);
+        slot->control = control2;
+        slot->volume = sessionVolume;
+      }
+      present.insert(session.handle);
+
+      // Sessions shared by several processes report AUDCLNT_S_NO_SINGLE_PROCESS, which is a success code
+      checkErrors(control2->GetProcessId(&session.pid), "getting audio session process");
+      checkErrors(control->GetState(&session.state), "getting audio session state");
+      checkErrors(sessionVolume->GetMasterVolume(&session.volume), "getting audio session volume");
+      checkErrors(sessionVolume->GetMute(&session.muted), "getting audio session muted state");
+      session.systemSounds = control2->IsSystemSoundsSession() == S_OK;
+
+      if (created)
+      {
+        uint32_t handle = session.handle;
+        SessionSlot* slot = sessionHandles.get(handle);
+        history.record(handle, unixTimeMs(), session.volume, session.muted != FALSE);
+        slot->events.Attach(new SessionEventsListener(
+          [this, handle](float volume, BOOL muted, LPCGUID) {
+            uint64_t now = unixTimeMs();
+            history.record(handle, now, volume, muted != FALSE);
+            publisher.publishSessionVolume(HandleTable<SessionSlot>::indexOf(handle), handle, volume, muted != FALSE);
+            eventQueue->push(AudioEvent{AudioEventType::VolumeChanged, now, handle, volume, muted ? 1.0 : 0.0});
+          },
+          nullptr));
+        checkErrors(control2->RegisterAudioSessionNotification(slot->events.Get()), "watching audio session changes");
+      }
+
+      sessionStates.set(
+        HandleTable<SessionSlot>::indexOf(session.handle),
+        session.handle,
+        session.volume,
+        session.muted != FALSE,
+        static_cast<uint8_t>(session.state),
+        session.systemSounds ? SessionStateTable::SystemSounds : 0);
+      publisher.publishSession(
+        HandleTable<SessionSlot>::indexOf(session.handle),
+        PublishedSession{
+          session.handle,
+          session.pid,
+          session.volume,
+          static_cast<uint8_t>(session.muted ? 1 : 0),
+          static_cast<uint8_t>(session.state),
+          static_cast<uint8_t>(SessionStateTable::Live | (session.systemSounds ? SessionStateTable::SystemSounds : 0)),
+          0});
+
+      sessions.push_back(session);
+      pids.push_back(session.systemSounds ? 0 : session.pid);
+    }
+
+    // Sessions missing from the listing are gone, their handles must not reach a future session
+    sessionHandles.retain([&](uint32_t handle, SessionSlot& slot) {
+      bool keep = present.count(handle) != 0;
+      if (!keep)
+      {
+        slot.control->UnregisterAudioSessionNotification(slot.events.Get());
+        sessionStates.clear(HandleTable<SessionSlot>::indexOf(handle));
+        publisher.removeSession(HandleTable<SessionSlot>::indexOf(handle));
+      }
+      return keep;
+    });
+
+    // Resolve the names in one pass so the cache lock is taken once per listing
+    std::vector<std::wstring> names = ProcessNameCache::shared().resolveAll(pids);
+    for (size_t i = 0; i < sessions.size(); i++)
+    {
+      sessions[i].name = std::move(names[i]);
+    }
+
+    return sessions;
+  }
+
+  float readSessionVolume(uint32_t session)
+  {
+    float volume = 0;
+    checkErrors(sessionVolume(session)->GetMasterVolume(&volume), "getting audio session volume");
+    return volume;
+  }
+
+  BOOL readSessionMuted(uint32_t session)
+  {
+    BOOL muted = false;
+    checkErrors(sessionVolume(session)->GetMute(&muted), "getting audio session muted state");
+    return muted;
+  }
+
+public:
+  // Controls the default render endpoint when `deviceId` is empty
+  explicit BasicVolumeControl(const std::wstring& deviceId = std::wstring())
+  {
+    AUDIO_TRACE_SCOPE("create");
+    // The IMMDeviceEnumerator interface provides methods for enumerating multimedia device resources. Basically the interface of the requested object.
+    Microsoft::WRL::ComPtr<IMMDeviceEnumerator> deviceEnumerator;
+
+    // Creates a single uninitialized object of the class associated with a specified CLSID
+    checkErrors(
+      CoCreateInstance(
+        __uuidof(MMDeviceEnumerator),   // Requested COM device enumerator id
+        NULL,                           // If NULL, indicates that the object is not being created as part of an aggregate.
+        CLSCTX_INPROC_SERVER,           // Context in which the code that manages the newly created object will run (Same process).
+        IID_PPV_ARGS(&deviceEnumerator) // Address of pointer variable that receives the interface pointer requested in riid.
+      ),
+      "Error when trying to get a handle to MMDeviceEnumerator device enumerator");
+
+    // Device interface pointer where we will dig the audio device endpoint, kept for activating the session manager later
+    if (deviceId.empty())
+    {
+      checkErrors(
+        deviceEnumerator->GetDefaultAudioEndpoint(
+          eRender,       // Audio rendering stream. Audio data flows from the application to the audio endpoint device, which renders the stream. eCapture would be the opposite
+          eConsole,      // The role that the system has assigned to an audio endpoint device. eConsole for games, system notification sounds, and voice commands
+          &endpoint      // Pointer to default audio enpoint device
+        ),
+        "Error when trying to get a handle to the default audio enpoint");
+    }
+    else
+    {
+      checkErrors(
+        deviceEnumerator->GetDevice(deviceId.c_str(), &endpoint),
+        "Error when trying to get a handle to the requested audio endpoint");
+    }
+
+    checkErrors(
+      endpoint->Activate(                 // Creates a COM object with the specified interface.
+        __uuidof(IAudioEndpointVolume), // Reference to a GUID that identifies the interface that the caller requests be activated
+        CLSCTX_INPROC_SERVER,           // Context in which the code that manages the newly created object will run (Same process).
+        NULL,                           // Set NULL to activate the IAudioEndpointVolume endpoint https://msdn.microsoft.com/en-us/library/ms679029.aspx
+        &device                         //  Pointer to a pointer variable into which the method writes the address of the interface specified by parameter iid. Through this method, the caller obtains a counted reference to the interface.
+      ),
+      "Error when trying to get a handle to the volume endpoint");
+
+    // Changes from any application are recorded as they happen, starting from the current state
+    history.record(deviceSeries, unixTimeMs(), readVolume(), readMuted() != FALSE);
+    volumeListener.Attach(new EndpointVolumeListener([this](const AUDIO_VOLUME_NOTIFICATION_DATA& data) {
+      uint64_t now = unixTimeMs();
+      cache.storeVolume(data.fMasterVolume);
+      cache.storeMuted(data.bMuted);
+      history.record(deviceSeries, now, data.fMasterVolume, data.bMuted != FALSE);
+      publisher.publishDevice(data.fMasterVolume, data.bMuted != FALSE);
+      eventQueue->push(AudioEvent{AudioEventType::VolumeChanged, now, deviceSeries, data.fMasterVolume, data.bMuted ? 1.0 : 0.0});
+    }));
+    checkErrors(device->RegisterControlChangeNotify(volumeListener.Get()), "registering for volume changes");
+  }
+
+  // The notification handlers point back at this instance
+  BasicVolumeControl(const BasicVolumeControl&) = delete;
+  BasicVolumeControl& operator=(const BasicVolumeControl&) = delete;
+
+  ~BasicVolumeControl()
+  {
+    AUDIO_TRACE_SCOPE("release");
+    device->UnregisterControlChangeNotify(volumeListener.Get());
+    sessionHandles.forEach([](uint32_t, SessionSlot& slot) {
+      slot.control->UnregisterAudioSessionNotification(slot.events.Get());
+    });
+
+    // Sessions stay as they are, but the manager must stop calling into the watcher
+    if (focusWatcher)
+    {
+      manager->UnregisterSessionNotification(focusWatcher.Get());
+    }
+  }
+
+  BOOL isMuted()
+  {
+    AUDIO_TRACE_SCOPE("isMuted");
+    typename Locking::Guard guard(locking);
+    typename Instrumentation::Scope measured(instrumentation, ControlCall::IsMuted);
+    return readMuted();
+  }
+
+  void setMuted(BOOL muted)
+  {
+    AUDIO_TRACE_SCOPE("setMuted");
+    typename Locking::Guard guard(locking);
+    typename Instrumentation::Scope measured(instrumentation, ControlCall::SetMuted);
+    checkLease(LeaseControl::Mute);
+    BOOL before = readMuted();
+    checkErrors(device->SetMute(muted, NULL), "setting mute");
+    cache.storeMuted(muted);
+    journal.record(MixerControl::DeviceMute, 0, before ? 1.0f : 0.0f, muted ? 1.0f : 0.0f, GetTickCount64());
+  }
+
+  float getVolume()
+  {
+    AUDIO_TRACE_SCOPE("getVolume");
+    typename Locking::Guard guard(locking);
+    typename Instrumentation::Scope measured(instrumentation, ControlCall::GetVolume);
+    return readVolume();
+  }
+
+  void setVolume(float volume)
+  {
+    AUDIO_TRACE_SCOPE("setVolume");
+    typename Locking::Guard guard(locking);
+    typename Instrumentation::Scope measured(instrumentation, ControlCall::SetVolume);
+    if (volume < 0.0 || volume > 1.0)
+    {
+      throw std::string("Volume needs to be between 0.0 and 1.0 inclusive");
+    }
+
+    checkLease(LeaseControl::Volume);
+    float before = readVolume();
+
+    checkErrors(
+      device->SetMasterVolumeLevelScalar(volume, NULL),
+      "setting volume");
+    cache.storeVolume(volume);
+
+    journal.record(MixerControl::DeviceVolume, 0, before, volume, GetTickCount64());
+  }
+
+  std::vector<AudioSession> getSessions()
+  {
+    AUDIO_TRACE_SCOPE("getSessions");
+    typename Locking::Guard guard(locking);
+    typename Instrumentation::Scope measured(instrumentation, ControlCall::GetSessions);
+    return listSessions();
+  }
+
+  // Handle of a session instance id, listing the sessions again if it started since the last listing
+  uint32_t sessionHandle(const std::wstring& id)
+  {
+    AUDIO_TRACE_SCOPE("sessionHandle");
+    typename Locking::Guard guard(locking);
+    uint32_t handle = sessionHandles.find(id);
+    if (handle == HandleTable<SessionSlot>::invalidHandle)
+    {
+      listSessions();
+      handle = sessionHandles.find(id);
+    }
+    if (handle == HandleTable<SessionSlot>::invalidHandle)
+    {
+      throw std::string("Unknown audio session");
+    }
+    return handle;
+  }
+
+  float getSessionVolume(uint32_t session)
+  {
+    AUDIO_TRACE_SCOPE("getSessionVolume");
+    typename Locking::Guard guard(locking);
+    typename Instrumentation::Scope measured(instrumentation, ControlCall::GetSessionVolume);
+    return readSessionVolume(session);
+  }
+
+  void setSessionVolume(uint32_t session, float volume)
+  {
+    AUDIO_TRACE_SCOPE("setSessionVolume");
+    typename Locking::Guard guard(locking);
+    typename Instrumentation::Scope measured(instrumentation, ControlCall::SetSessionVolume);
+    if (volume < 0.0 || volume > 1.0)
+    {
+      throw std::string("Volume needs to be between 0.0 and 1.0 inclusive");
+    }
+    float before = readSessionVolume(session);
+    writeSessionVolume(session, volume);
+    journal.record(MixerControl::SessionVolume, session, before, volume, GetTickCount64());
+  }
+
+  BOOL isSessionMuted(uint32_t session)
+  {
+    AUDIO_TRACE_SCOPE("isSessionMuted");
+    typename Locking::Guard guard(locking);
+    typename Instrumentation::Scope measured(instrumentation, ControlCall::IsSessionMuted);
+    return readSessionMuted(session);
+  }
+
+  void setSessionMuted(uint32_t session, BOOL muted)
+  {
+    AUDIO_TRACE_SCOPE("setSessionMuted");
+    typename Locking::Guard guard(locking);
+    typename Instrumentation::Scope measured(instrumentation, ControlCall::SetSessionMuted);
+    BOOL before = readSessionMuted(session);
+    writeSessionMuted(session, muted);
+    journal.record(MixerControl::SessionMute, session, before ? 1.0f : 0.0f, muted ? 1.0f : 0.0f, GetTickCount64());
+  }
+
+  // Per-slot session state columns, refreshed by getSessions() and the session setters
+  const SessionStateTable& sessionTable() const
+  {
+    return sessionStates;
+  }
+
+  // Multiplies every session volume by `factor`. Only sessions whose volume actually changes are
+  // written, the number of writes is returned.
+  size_t scaleSessionVolumes(float factor)
+  {
+    AUDIO_TRACE_SCOPE("scaleSessionVolumes");
+    typename Locking::Guard guard(locking);
+    if (factor < 0.0)
+    {
+      throw std::string("The volume factor cannot be negative");
+    }
+
+    // Listing first picks up sessions started since the last call and volumes changed by other applications
+    listSessions();
+
+    std::vector<float> targets;
+    std::vector<uint32_t> changed;
+    sessionStates.planScale(factor, targets, changed);
+
+    MixerJournalGroup group(journal);
+    ULONGLONG now = GetTickCount64();
+    for (uint32_t index : changed)
+    {
+      uint32_t session = sessionStates.handleColumn()[index];
+      float before = sessionStates.volumeColumn()[index];
+      writeSessionVolume(session, targets[index]);
+      journal.record(MixerControl::SessionVolume, session, before, targets[index], now);
+    }
+    return changed.size();
+  }
+
+  // Mutes or unmutes every session except `keep`, which may be HandleTable::invalidHandle to
+  // include all of them. Only sessions whose state changes are written, their count is returned.
+  size_t setSessionsMuted(BOOL muted, uint32_t keep)
+  {
+    AUDIO_TRACE_SCOPE("setSessionsMuted");
+    typename Locking::Guard guard(locking);
+    listSessions();
+
+    uint32_t keepIndex = UINT32_MAX;
+    if (keep != HandleTable<SessionSlot>::invalidHandle)
+    {
+      sessionVolume(keep); // Rejects stale handles before anything is written
+      keepIndex = HandleTable<SessionSlot>::indexOf(keep);
+    }
+
+    std::vector<uint8_t> targets;
+    std::vector<uint32_t> changed;
+    sessionStates.planMuteExcept(keepIndex, muted != FALSE, targets, changed);
+
+    MixerJournalGroup group(journal);
+    ULONGLONG now = GetTickCount64();
+    for (uint32_t index : changed)
+    {
+      uint32_t session = sessionStates.handleColumn()[index];
+      writeSessionMuted(session, targets[index]);
+      journal.record(MixerControl::SessionMute, session, targets[index] ? 0.0f : 1.0f, targets[index] ? 1.0f : 0.0f, now);
+    }
+    return changed.size();
+  }
+
+  // Mutes every session that does not match `handle`, or `text` as a session id or executable
+  // name, in one batched pass. Sessions created while focused are muted as they appear. Returns
+  // the number of sessions muted, unfocus() restores exactly those.
+  size_t focus(uint32_t handle, const std::wstring& text)
+  {
+    AUDIO_TRACE_SCOPE("focus");
+    typename Locking::Guard guard(locking);
+    unfocus();
+
+    std::vector<AudioSession> sessions = listSessions();
+    std::wstring name = toLowerCase(text);
+    std::vector<uint8_t> keep(sessionStates.size(), 0);
+    std::unordered_set<DWORD> keptPids;
+    std::unordered_set<std::wstring> keptNames;
+    bool matched = false;
+    for (const AudioSession& session : sessions)
+    {
+      bool byName = !name.empty() && toLowerCase(session.name) == name;
+      if (session.handle == handle || (!text.empty() && session.id == text) || byName)
+      {
+        keep[HandleTable<SessionSlot>::indexOf(session.handle)] = 1;
+        matched = true;
+        if (!session.systemSounds)
+        {
+          keptPids.insert(session.pid);
+        }
+        if (byName)
+        {
+          keptNames.insert(name);
+        }
+      }
+    }
+    if (!matched)
+    {
+      throw std::string("No audio session matches the focus selector");
+    }
+
+    // The watcher goes in before the mutes so a session starting in between is not missed
+    Microsoft::WRL::ComPtr<FocusSessionWatcher> watcher;
+    watcher.Attach(new FocusSessionWatcher(keptPids, keptNames));
+    checkErrors(sessionManager()->RegisterSessionNotification(watcher.Get()), "watching for new audio sessions");
+    focusWatcher = watcher;
+
+    std::vector<uint8_t> targets;
+    std::vector<uint32_t> changed;
+    sessionStates.planMuteExcept(keep, true, targets, changed);
+    for (uint32_t index : changed)
+    {
+      uint32_t session = sessionStates.handleColumn()[index];
+      writeSessionMuted(session, TRUE);
+      focusMuted.push_back(session);
+    }
+    return changed.size();
+  }
+
+  bool isFocused() const
+  {
+    typename Locking::Guard guard(locking);
+    return focusWatcher != nullptr;
+  }
+
+  // Unmutes what focus() muted, including sessions muted on creation. Returns how many.
+  size_t unfocus()
+  {
+    AUDIO_TRACE_SCOPE("unfocus");
+    typename Locking::Guard guard(locking);
+    if (!focusWatcher)
+    {
+      return 0;
+    }
+
+    sessionManager()->UnregisterSessionNotification(focusWatcher.Get());
+    auto lateSessions = focusWatcher->takeMutedSessions();
+    focusWatcher.Reset();
+
+    size_t restored = 0;
+    for (uint32_t session : focusMuted)
+    {
+      // Sessions that ended while focused have nothing left to restore
+      if (sessionHandles.contains(session))
+      {
+        writeSessionMuted(session, FALSE);
+        restored++;
+      }
+    }
+    focusMuted.clear();
+
+    for (auto& volume : lateSessions)
+    {
+      if (SUCCEEDED(volume->SetMute(FALSE, NULL)))
+      {
+        restored++;
+      }
+    }
+    return restored;
+  }
+
+  // Reverts the latest change or batch operation, returns the number of writes made. A step that
+  // fails partway stays the one to undo, repeating it writes the records already restored again.
+  size_t undo()
+  {
+    AUDIO_TRACE_SCOPE("undo");
+    typename Locking::Guard guard(locking);
+    std::vector<JournalRecord> step = journal.nextUndo();
+    size_t writes = replay(step, true);
+    journal.undone(step);
+    return writes;
+  }
+
+  size_t redo()
+  {
+    AUDIO_TRACE_SCOPE("redo");
+    typename Locking::Guard guard(locking);
+    std::vector<JournalRecord> step = journal.nextRedo();
+    size_t writes = replay(step, false);
+    journal.redone(step);
+    return writes;
+  }
+
+  bool canUndo() const
+  {
+    typename Locking::Guard guard(locking);
+    return journal.canUndo();
+  }
+
+  bool canRedo() const
+  {
+    typename Locking::Guard guard(locking);
+    return journal.canRedo();
+  }
+
+  // Recorded volume and mute of the device, or of a session when `session` is a handle
+  VolumeHistory::Range volumeHistory(uint32_t session, uint64_t fromMs, uint64_t toMs, VolumeHistory::Resolution resolution)
+  {
+    AUDIO_TRACE_SCOPE("volumeHistory");
+    typename Locking::Guard guard(locking);
+    if (session != deviceSeries)
+    {
+      sessionVolume(session); // Rejects stale handles
+    }
+    return history.query(session, fromMs, toMs, resolution);
+  }
+
+  std::wstring endpointId()
+  {
+    AUDIO_TRACE_SCOPE("endpointId");
+    typename Locking::Guard guard(locking);
+    LPWSTR id = NULL;
+    checkErrors(endpoint->GetId(&id), "getting the endpoint id");
+    std::wstring result(id);
+    CoTaskMemFree(id);
+    return result;
+  }
+
+  // Publishes the state under publishedStateName() and returns that name. Volume changes are
+  // published as they happen, the session list as of the latest getSessions().
+  std::wstring startPublishing()
+  {
+    AUDIO_TRACE_SCOPE("startPublishing");
+    typename Locking::Guard guard(locking);
+    std::wstring name = publishedStateName(endpointId());
+    publisher.open(name);
+    publisher.publishDevice(readVolume(), readMuted() != FALSE);
+    listSessions();
+    return name;
+  }
+
+  void stopPublishing()
+  {
+    AUDIO_TRACE_SCOPE("stopPublishing");
+    typename Locking::Guard guard(locking);
+    publisher.close();
+  }
+
+  bool isPublishing() const
+  {
+    typename Locking::Guard guard(locking);
+    return publisher.isOpen();
+  }
+
+  // Joins the lease of the endpoint for the controls in `controls`, a bit per LeaseControl. Until
+  // this process owns a control, writing it throws.
+  void joinLease(uint32_t controls, uint16_t priority)
+  {
+    AUDIO_TRACE_SCOPE("joinLease");
+    typename Locking::Guard guard(locking);
+    lease.reset();
+    lease.reset(new EndpointLease(endpointId(), controls, priority, eventQueue));
+  }
+
+  void leaveLease()
+  {
+    AUDIO_TRACE_SCOPE("leaveLease");
+    typename Locking::Guard guard(locking);
+    lease.reset();
+  }
+
+  // True without a lease, every process may write then
+  bool mayWrite(LeaseControl control)
+  {
+    AUDIO_TRACE_SCOPE("mayWrite");
+    typename Locking::Guard guard(locking);
+    return !lease || lease->holds(control);
+  }
+
+  // Pid of the process owning the control, 0 when nobody does or this process has not joined
+  uint32_t leaseOwner(LeaseControl control)
+  {
+    AUDIO_TRACE_SCOPE("leaseOwner");
+    typename Locking::Guard guard(locking);
+    return lease ? lease->owner(control) : 0;
+  }
+
+  // Restarting drops the recorded samples
+  void startMetering(DWORD intervalMs, size_t capacity)
+  {
+    AUDIO_TRACE_SCOPE("startMetering");
+    typename Locking::Guard guard(locking);
+    meter.reset();
+    meter.reset(new MeterSampler(endpointId(), intervalMs, capacity, eventQueue));
+    meter->setExposure(exposure);
+    meter->setSilenceDetection(silenceDetection, silenceSettings);
+  }
+
+  // Stopping the meter pauses exposure tracking as well
+  void stopMetering()
+  {
+    AUDIO_TRACE_SCOPE("stopMetering");
+    typename Locking::Guard guard(locking);
+    meter.reset();
+  }
+
+  bool isMetering() const
+  {
+    typename Locking::Guard guard(locking);
+    return meter != nullptr;
+  }
+
+  // Consecutive windows of `windowMs` covering [fromMs, toMs], the last one possibly shorter
+  std::vector<MeterWindow> queryMeter(uint64_t fromMs, uint64_t toMs, uint64_t windowMs, float threshold, float percentile)
+  {
+    AUDIO_TRACE_SCOPE("queryMeter");
+    typename Locking::Guard guard(locking);
+    if (!meter)
+    {
+      throw std::string("Metering has not been started.");
+    }
+    std::vector<MeterWindow> windows;
+    for (uint64_t start = fromMs; start <= toMs; start += windowMs)
+    {
+      windows.push_back(meter->history().query(start, std::min(toMs, start + windowMs - 1), threshold, percentile));
+      if (toMs - start < windowMs)
+      {
+        break;
+      }
+    }
+    return windows;
+  }
+
+  // Starts the meter with its defaults if it is not running. Without a file the dose starts from
+  // zero every time.
+  void startExposureTracking(const ExposureDose::Settings& settings, const std::wstring& file)
+  {
+    AUDIO_TRACE_SCOPE("startExposureTracking");
+    typename Locking::Guard guard(locking);
+    stopExposureTracking();
+    std::shared_ptr<ExposureRecord> record;
+    if (!file.empty())
+    {
+      // Aliases the mapping, which is unmapped with the last reference to the record
+      auto mapped = std::make_shared<MappedRecord<ExposureRecord>>(file);
+      record = std::shared_ptr<ExposureRecord>(mapped, &mapped->get());
+    }
+    exposure = std::make_shared<ExposureDose>(settings, std::move(record));
+    if (!meter)
+    {
+      startMetering(50, 65536);
+    }
+    meter->setExposure(exposure);
+  }
+
+  void stopExposureTracking()
+  {
+    AUDIO_TRACE_SCOPE("stopExposureTracking");
+    typename Locking::Guard guard(locking);
+    if (meter)
+    {
+      meter->setExposure(nullptr);
+    }
+    exposure.reset();
+  }
+
+  // Starts the meter with its defaults if it is not running
+  void setSilenceDetection(bool enabled, const SilenceDetector::Settings& settings)
+  {
+    AUDIO_TRACE_SCOPE("setSilenceDetection");
+    typename Locking::Guard guard(locking);
+    silenceDetection = enabled;
+    silenceSettings = settings;
+    if (enabled && !meter)
+    {
+      startMetering(50, 65536);
+    }
+    else if (meter)
+    {
+      meter->setSilenceDetection(enabled, settings);
+    }
+  }
+
+  bool isSilent() const
+  {
+    typename Locking::Guard guard(locking);
+    return meter && meter->isSilent();
+  }
+
+  // Only works on capture endpoints
+  void startVoiceDetection(const VoiceActivityDetector::Settings& settings, bool autoMute)
+  {
+    AUDIO_TRACE_SCOPE("startVoiceDetection");
+    typename Locking::Guard guard(locking);
+    voice.reset();
+    voice.reset(new VoiceActivityMonitor(endpointId(), settings, autoMute, eventQueue));
+  }
+
+  void stopVoiceDetection()
+  {
+    AUDIO_TRACE_SCOPE("stopVoiceDetection");
+    typename Locking::Guard guard(locking);
+    voice.reset();
+  }
+
+  bool isSpeaking() const
+  {
+    typename Locking::Guard guard(locking);
+    return voice && voice->isSpeaking();
+  }
+
+  ExposureDose& exposureDose()
+  {
+    if (!exposure)
+    {
+      throw std::string("Exposure tracking has not been started.");
+    }
+    return *exposure;
+  }
+
+  const std::shared_ptr<EventQueue>& events() const
+  {
+    return eventQueue;
+  }
+
+  // All zero unless the instrumentation counts calls
+  CallStats callStats() const
+  {
+    return instrumentation.stats();
+  }
+
+  static const bool countsCalls = Instrumentation::enabled;
+};
+
+typedef BasicVolumeControl<NoInstrumentation, NoLocking, UncachedEndpoint> PlainVolumeControl;
+typedef BasicVolumeControl<CallCounters, NoLocking, UncachedEndpoint> CountedVolumeControl;
+typedef BasicVolumeControl<NoInstrumentation, NoLocking, NotifiedEndpointCache> CachedVolumeControl;
+typedef BasicVolumeControl<CallCounters, NoLocking, NotifiedEndpointCache> CountedCachedVolumeControl;
+typedef BasicVolumeControl<NoInstrumentation, MutexLocking, UncachedEndpoint> SharedVolumeControl; // Safe to share between threads
+
+extern template class BasicVolumeControl<NoInstrumentation, NoLocking, UncachedEndpoint>;
+extern template class BasicVolumeControl<CallCounters, NoLocking, UncachedEndpoint>;
+extern template class BasicVolumeControl<NoInstrumentation, NoLocking, NotifiedEndpointCache>;
+extern template class BasicVolumeControl<CallCounters, NoLocking, NotifiedEndpointCache>;
+extern template class BasicVolumeControl<NoInstrumentation, MutexLocking, UncachedEndpoint>;
+
+// The controller of the addon and audiod, picked with the gyp variables audio_call_stats and
+// audio_cached_reads. Both are used by one thread at a time.
+#if defined(AUDIO_CALL_STATS) && defined(AUDIO_CACHED_READS)
+typedef CountedCachedVolumeControl VolumeControl;
+#elif defined(AUDIO_CALL_STATS)
+typedef CountedVolumeControl VolumeControl;
+#elif defined(AUDIO_CACHED_READS)
+typedef CachedVolumeControl VolumeControl;
+#else
+typedef PlainVolumeControl VolumeControl;
+#endif
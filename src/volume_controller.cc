@@ -1,109 +1,339 @@
 #pragma once
 #define _WINSOCKAPI_
 #include <windows.h>
+#include <initguid.h> // Defines the PKEY_* property keys used by the device metadata cache in this translation unit
 #include <mmdeviceapi.h>
 #include <endpointvolume.h>
+#include <audiopolicy.h>
 #include <stdio.h>
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include <nan.h>
 #include <wrl/client.h> 
+#include "capture_privacy.h"
+#include "check_errors.h"
+#include "clock.h"
+#include "default_device_cache.h"
+#include "device_metadata_cache.h"
+#include "event_queue.h"
+#include "js_strings.h"
+#include "lock_stats.h"
+#include "microphone_mute.h"
+#include "object_counts.h"
+#include "process_name_cache.h"
+#include "state_publisher.h"
+#include "tracepoints.h"
+#include "volume_control.h"
 
-using Microsoft::WRL::ComPtr;
+AUDIO_TRACE_PROVIDER_DEFINITION();
 
-template <typename... Args>
-std::string string_format(std::string format, Args... args)
+std::wstring toWideString(v8::Local<v8::Value> value)
 {
-  size_t size = std::snprintf(nullptr, 0, format.c_str(), args...) + 1; // Extra space for '\0'
-  std::unique_ptr<char[]> buf(new char[size]);
-  std::snprintf(buf.get(), size, format.c_str(), args...);
-  return std::string(buf.get(), buf.get() + size - 1); // We don't want the '\0' inside
+  Nan::Utf8String utf8(value);
+  int length = MultiByteToWideChar(CP_UTF8, 0, *utf8, utf8.length(), NULL, 0);
+  std::wstring result(length, L'\0');
+  MultiByteToWideChar(CP_UTF8, 0, *utf8, utf8.length(), &result[0], length);
+  return result;
 }
 
-void checkErrors(HRESULT hr, std::string error_message)
+// Copies native values into a fresh typed array, e.g. toTypedArray<v8::Uint32Array>(values.data(), values.size())
+template <typename TypedArray, typename T>
+v8::Local<TypedArray> toTypedArray(const T* values, size_t count)
 {
-  if (FAILED(hr))
+  auto buffer = v8::ArrayBuffer::New(v8::Isolate::GetCurrent(), count * sizeof(T));
+  auto array = TypedArray::New(buffer, 0, count);
+  Nan::TypedArrayContents<T> contents(array);
+  std::copy(values, values + count, *contents);
+  return array;
+}
+
+const char* sessionStateName(AudioSessionState state)
+{
+  switch (state)
   {
-    throw string_format("%s (0x%X)", error_message.c_str(), hr);
+    case AudioSessionStateActive:
+      return "active";
+    case AudioSessionStateExpired:
+      return "expired";
+    default:
+      return "inactive";
   }
 }
 
-class VolumeControl
+// The current default endpoint for { flow?: 'render' | 'capture', role?: 'console' | 'multimedia' |
+// 'communications' }, empty when there is none
+std::wstring defaultDeviceArgument(v8::Local<v8::Object> options)
 {
-private:
-  ComPtr<IAudioEndpointVolume> device;
+  auto flowOption = Nan::Get(options, Nan::New("flow").ToLocalChecked()).ToLocalChecked();
+  auto roleOption = Nan::Get(options, Nan::New("role").ToLocalChecked()).ToLocalChecked();
+  EDataFlow flow = eRender;
+  ERole role = eConsole;
 
-public:
-  VolumeControl()
+  if (!flowOption->IsUndefined())
+  {
+    std::string name = *Nan::Utf8String(flowOption);
+    if (name == "capture")
+    {
+      flow = eCapture;
+    }
+    else if (name != "render")
+    {
+      throw std::string("The flow must be 'render' or 'capture'.");
+    }
+  }
+  if (!roleOption->IsUndefined())
   {
-    // The IMMDeviceEnumerator interface provides methods for enumerating multimedia device resources. Basically the interface of the requested object.
-    ComPtr<IMMDeviceEnumerator> deviceEnumerator;
+    std::string name = *Nan::Utf8String(roleOption);
+    if (name == "multimedia")
+    {
+      role = eMultimedia;
+    }
+    else if (name == "communications")
+    {
+      role = eCommunications;
+    }
+    else if (name != "console")
+    {
+      throw std::string("The role must be 'console', 'multimedia' or 'communications'.");
+    }
+  }
+  return DefaultDeviceCache::shared().defaultId(flow, role);
+}
 
-    // Creates a single uninitialized object of the class associated with a specified CLSID
-    checkErrors(
-      CoCreateInstance(
-        __uuidof(MMDeviceEnumerator),   // Requested COM device enumerator id
-        NULL,                           // If NULL, indicates that the object is not being created as part of an aggregate.
-        CLSCTX_INPROC_SERVER,           // Context in which the code that manages the newly created object will run (Same process).
-        IID_PPV_ARGS(&deviceEnumerator) // Address of pointer variable that receives the interface pointer requested in riid.
-      ),
-      "Error when trying to get a handle to MMDeviceEnumerator device enumerator");
+// Devices are passed as an endpoint id string, a handle from getDevices() or the flow and role of
+// a default device
+std::wstring deviceArgument(v8::Local<v8::Value> value)
+{
+  if (value->IsUndefined())
+  {
+    return std::wstring();
+  }
+  if (value->IsNumber())
+  {
+    return DeviceMetadataCache::shared().idOf(Nan::To<uint32_t>(value).FromJust());
+  }
+  if (value->IsString())
+  {
+    return toWideString(value);
+  }
+  if (value->IsObject())
+  {
+    std::wstring id = defaultDeviceArgument(value.As<v8::Object>());
+    if (id.empty())
+    {
+      throw std::string("There is no default device for that flow and role.");
+    }
+    return id;
+  }
+  throw std::string("The device must be an endpoint id, a device handle or a flow and role.");
+}
 
-    // Device interface pointer where we will dig the audio device endpoint
-    ComPtr<IMMDevice> defaultDevice;
+const char* eventTypeName(AudioEventType type)
+{
+  switch (type)
+  {
+    case AudioEventType::ExposureThreshold:
+      return "exposure";
+    case AudioEventType::SilenceStarted:
+      return "silenceStart";
+    case AudioEventType::SilenceEnded:
+      return "silenceEnd";
+    case AudioEventType::VoiceStarted:
+      return "voiceStart";
+    case AudioEventType::VoiceStopped:
+      return "voiceStop";
+    case AudioEventType::MuteConfirmed:
+      return "muteConfirmed";
+    case AudioEventType::MuteFailed:
+      return "muteFailed";
+    case AudioEventType::VolumeChanged:
+      return "volume";
+    case AudioEventType::LeaseChanged:
+      return "lease";
+    default:
+      return "unknown";
+  }
+}
 
-    checkErrors(
-      deviceEnumerator->GetDefaultAudioEndpoint(
-        eRender,       // Audio rendering stream. Audio data flows from the application to the audio endpoint device, which renders the stream. eCapture would be the opposite
-        eConsole,      // The role that the system has assigned to an audio endpoint device. eConsole for games, system notification sounds, and voice commands
-        &defaultDevice // Pointer to default audio enpoint device
-      ),
-      "Error when trying to get a handle to the default audio enpoint");
+const char* leaseControlName(LeaseControl control)
+{
+  return control == LeaseControl::Mute ? "mute" : "volume";
+}
 
-    checkErrors(
-      defaultDevice->Activate(            // Creates a COM object with the specified interface.
-        __uuidof(IAudioEndpointVolume), // Reference to a GUID that identifies the interface that the caller requests be activated
-        CLSCTX_INPROC_SERVER,           // Context in which the code that manages the newly created object will run (Same process).
-        NULL,                           // Set NULL to activate the IAudioEndpointVolume endpoint https://msdn.microsoft.com/en-us/library/ms679029.aspx
-        &device                         //  Pointer to a pointer variable into which the method writes the address of the interface specified by parameter iid. Through this method, the caller obtains a counted reference to the interface.
-      ),
-      "Error when trying to get a handle to the volume endpoint");
+// 'volume' or 'mute', the volume when omitted
+LeaseControl leaseControlArgument(v8::Local<v8::Value> value)
+{
+  if (value->IsUndefined())
+  {
+    return LeaseControl::Volume;
   }
-
-  BOOL isMuted()
+  std::string name = *Nan::Utf8String(value);
+  if (name == "mute")
   {
-    BOOL muted = false;
+    return LeaseControl::Mute;
+  }
+  if (name != "volume")
+  {
+    throw std::string("The control must be 'volume' or 'mute'.");
+  }
+  return LeaseControl::Volume;
+}
 
-    checkErrors(device->GetMute(&muted), "getting muted state");
+// Fields of one event in a packed batch: type code, time, target, value, detail
+const size_t packedEventStride = 5;
 
-    return muted;
+v8::Local<v8::Float64Array> toPackedEvents(const std::vector<AudioEvent>& events)
+{
+  std::vector<double> packed;
+  packed.reserve(events.size() * packedEventStride);
+  for (const AudioEvent& event : events)
+  {
+    packed.push_back(static_cast<double>(event.type));
+    packed.push_back(static_cast<double>(event.time));
+    packed.push_back(event.target);
+    packed.push_back(event.value);
+    packed.push_back(event.detail);
   }
+  return toTypedArray<v8::Float64Array>(packed.data(), packed.size());
+}
 
-  void setMuted(BOOL muted)
+v8::Local<v8::Object> toJsEvent(const AudioEvent& event)
+{
+  auto object = Nan::New<v8::Object>();
+  Nan::Set(object, Nan::New("type").ToLocalChecked(), Nan::New(eventTypeName(event.type)).ToLocalChecked());
+  switch (event.type)
   {
-    checkErrors(device->SetMute(muted, NULL), "setting mute");
+    case AudioEventType::ExposureThreshold:
+      Nan::Set(object, Nan::New("dose").ToLocalChecked(), Nan::New(event.value));
+      Nan::Set(object, Nan::New("threshold").ToLocalChecked(), Nan::New(event.detail));
+      break;
+    case AudioEventType::SilenceStarted:
+    case AudioEventType::SilenceEnded:
+      Nan::Set(object, Nan::New("since").ToLocalChecked(), Nan::New(event.value));
+      break;
+    case AudioEventType::VoiceStarted:
+    case AudioEventType::VoiceStopped:
+      Nan::Set(object, Nan::New("frameTime").ToLocalChecked(), Nan::New(event.value));
+      break;
+    case AudioEventType::VolumeChanged:
+      Nan::Set(object, Nan::New("target").ToLocalChecked(), Nan::New(event.target));
+      Nan::Set(object, Nan::New("volume").ToLocalChecked(), Nan::New(event.value));
+      Nan::Set(object, Nan::New("muted").ToLocalChecked(), Nan::New(event.detail != 0));
+      break;
+    case AudioEventType::LeaseChanged:
+      Nan::Set(object, Nan::New("control").ToLocalChecked(), Nan::New(leaseControlName(static_cast<LeaseControl>(event.target))).ToLocalChecked());
+      Nan::Set(object, Nan::New("owner").ToLocalChecked(), Nan::New(event.value));
+      Nan::Set(object, Nan::New("isOwner").ToLocalChecked(), Nan::New(event.detail != 0));
+      break;
+    default:
+      break; // Mute completions go to the callback of their request
   }
+  Nan::Set(object, Nan::New("time").ToLocalChecked(), Nan::New(static_cast<double>(event.time)));
+  return object;
+}
+
+// Hands the events of a queue to `sink` on the loop thread. While the queue reports the loop as
+// lagging, everything waiting goes to `batchSink` in one call instead, if there is one. The async
+// handle does not keep the process alive and is closed, not freed, when the dispatcher goes away.
+class JsEventDispatcher
+{
+public:
+  typedef std::function<void(const AudioEvent&)> Sink;
+  typedef std::function<void(const std::vector<AudioEvent>&)> BatchSink;
 
-  float getVolume()
+  JsEventDispatcher(std::shared_ptr<EventQueue> queue, Sink sink, BatchSink batchSink = nullptr)
+    : queue(std::move(queue)), sink(std::move(sink)), batchSink(std::move(batchSink))
   {
-    float currentVolume = 0;
+    start();
+  }
 
-    checkErrors(
-      device->GetMasterVolumeLevelScalar(&currentVolume),
-      "getting volume");
+  // Pull mode: `signal` is called when events are waiting and the consumer drains at its own pace
+  JsEventDispatcher(std::shared_ptr<EventQueue> queue, std::function<void()> signal)
+    : queue(std::move(queue)), signal(std::move(signal))
+  {
+    start();
+  }
 
-    return currentVolume;
+  ~JsEventDispatcher()
+  {
+    queue->setWake(nullptr);
+    async->data = NULL;
+    uv_close(reinterpret_cast<uv_handle_t*>(async), [](uv_handle_t* handle) {
+      delete reinterpret_cast<uv_async_t*>(handle);
+    });
   }
 
-  void setVolume(float volume)
+  JsEventDispatcher(const JsEventDispatcher&) = delete;
+  JsEventDispatcher& operator=(const JsEventDispatcher&) = delete;
+
+  // Whether the loop waits for further events, e.g. while requests are outstanding
+  void keepAlive(bool alive)
   {
-    if (volume < 0.0 || volume > 1.0)
+    if (alive)
+    {
+      uv_ref(reinterpret_cast<uv_handle_t*>(async));
+    }
+    else
     {
-      throw std::string("Volume needs to be between 0.0 and 1.0 inclusive");
+      uv_unref(reinterpret_cast<uv_handle_t*>(async));
     }
+  }
+
+private:
+  std::shared_ptr<EventQueue> queue;
+  Sink sink;
+  BatchSink batchSink;
+  std::function<void()> signal;
+  uv_async_t* async;
+  ObjectCount<NativeObject::EventDispatcher> counted;
+
+  void start()
+  {
+    async = new uv_async_t;
+    async->data = this;
+    uv_async_init(Nan::GetCurrentEventLoop(), async, deliver);
+    uv_unref(reinterpret_cast<uv_handle_t*>(async));
+    uv_async_t* handle = async;
+    queue->setWake([handle] { uv_async_send(handle); });
+  }
 
-    checkErrors(
-      device->SetMasterVolumeLevelScalar(volume, NULL),
-      "setting volume");
+  // Sends coalesce, so one wake up drains everything queued since the last one
+  static void deliver(uv_async_t* async)
+  {
+    auto self = static_cast<JsEventDispatcher*>(async->data);
+    if (self == NULL)
+    {
+      return;
+    }
+    Nan::HandleScope scope;
+    AUDIO_TRACE_DELIVER();
+    if (self->signal)
+    {
+      std::function<void()> signal = self->signal; // The consumer may destroy the dispatcher
+      signal();
+      return;
+    }
+    std::vector<AudioEvent> events = self->queue->drain();
+    if (self->batchSink && events.size() > 1 && self->queue->isLagging())
+    {
+      BatchSink batchSink = self->batchSink;
+      batchSink(events);
+      return;
+    }
+    Sink sink = self->sink;
+    for (const AudioEvent& event : events)
+    {
+      sink(event);
+      if (async->data == NULL)
+      {
+        return;
+      }
+    }
   }
 };
 
@@ -120,13 +350,130 @@ public:
     Nan::SetPrototypeMethod(tpl, "setVolume", SetVolume);
     Nan::SetPrototypeMethod(tpl, "isMuted", IsMuted);
     Nan::SetPrototypeMethod(tpl, "setMuted", SetMuted);
+    Nan::SetPrototypeMethod(tpl, "getSessions", GetSessions);
+    Nan::SetPrototypeMethod(tpl, "getSessionVolume", GetSessionVolume);
+    Nan::SetPrototypeMethod(tpl, "setSessionVolume", SetSessionVolume);
+    Nan::SetPrototypeMethod(tpl, "isSessionMuted", IsSessionMuted);
+    Nan::SetPrototypeMethod(tpl, "setSessionMuted", SetSessionMuted);
+    Nan::SetPrototypeMethod(tpl, "getSessionTable", GetSessionTable);
+    Nan::SetPrototypeMethod(tpl, "scaleSessionVolumes", ScaleSessionVolumes);
+    Nan::SetPrototypeMethod(tpl, "setSessionsMuted", SetSessionsMuted);
+    Nan::SetPrototypeMethod(tpl, "focus", Focus);
+    Nan::SetPrototypeMethod(tpl, "unfocus", Unfocus);
+    Nan::SetPrototypeMethod(tpl, "isFocused", IsFocused);
+    Nan::SetPrototypeMethod(tpl, "undo", Undo);
+    Nan::SetPrototypeMethod(tpl, "redo", Redo);
+    Nan::SetPrototypeMethod(tpl, "canUndo", CanUndo);
+    Nan::SetPrototypeMethod(tpl, "canRedo", CanRedo);
+    Nan::SetPrototypeMethod(tpl, "getVolumeHistory", GetVolumeHistory);
+    Nan::SetPrototypeMethod(tpl, "startMetering", StartMetering);
+    Nan::SetPrototypeMethod(tpl, "stopMetering", StopMetering);
+    Nan::SetPrototypeMethod(tpl, "isMetering", IsMetering);
+    Nan::SetPrototypeMethod(tpl, "queryMeter", QueryMeter);
+    Nan::SetPrototypeMethod(tpl, "startExposureTracking", StartExposureTracking);
+    Nan::SetPrototypeMethod(tpl, "stopExposureTracking", StopExposureTracking);
+    Nan::SetPrototypeMethod(tpl, "getExposure", GetExposure);
+    Nan::SetPrototypeMethod(tpl, "setEventHandler", SetEventHandler);
+    Nan::SetPrototypeMethod(tpl, "setEventSignal", SetEventSignal);
+    Nan::SetPrototypeMethod(tpl, "readEvents", ReadEvents);
+    Nan::SetPrototypeMethod(tpl, "setEventCapacity", SetEventCapacity);
+    Nan::SetPrototypeMethod(tpl, "getEventStats", GetEventStats);
+    Nan::SetPrototypeMethod(tpl, "getCallStats", GetCallStats);
+    Nan::SetPrototypeMethod(tpl, "setSilenceDetection", SetSilenceDetection);
+    Nan::SetPrototypeMethod(tpl, "isSilent", IsSilent);
+    Nan::SetPrototypeMethod(tpl, "startVoiceDetection", StartVoiceDetection);
+    Nan::SetPrototypeMethod(tpl, "stopVoiceDetection", StopVoiceDetection);
+    Nan::SetPrototypeMethod(tpl, "isSpeaking", IsSpeaking);
+    Nan::SetPrototypeMethod(tpl, "startPublishing", StartPublishing);
+    Nan::SetPrototypeMethod(tpl, "stopPublishing", StopPublishing);
+    Nan::SetPrototypeMethod(tpl, "isPublishing", IsPublishing);
+    Nan::SetPrototypeMethod(tpl, "joinLease", JoinLease);
+    Nan::SetPrototypeMethod(tpl, "leaveLease", LeaveLease);
+    Nan::SetPrototypeMethod(tpl, "holdsLease", HoldsLease);
+    Nan::SetPrototypeMethod(tpl, "getLeaseOwner", GetLeaseOwner);
+
+    Nan::SetPrototypeMethod(tpl, "dispose", Dispose);
+    Nan::SetMethod(tpl, "open", Open);
 
     constructor().Reset(Nan::GetFunction(tpl).ToLocalChecked());
     Nan::Set(target, Nan::New("VolumeControl").ToLocalChecked(), Nan::GetFunction(tpl).ToLocalChecked());
   }
 
+  // Releases every pooled controller, before COM goes away
+  static void clearPool()
+  {
+    for (auto& entry : pool())
+    {
+      entry.second->release();
+      entry.second->Unref();
+    }
+    pool().clear();
+  }
+
+  static size_t liveCount()
+  {
+    return live();
+  }
+
+  static size_t pooledCount()
+  {
+    return pool().size();
+  }
+
 private:
-  VolumeControl device;
+  std::unique_ptr<VolumeControl> device; // Null once disposed
+  std::unique_ptr<JsEventDispatcher> dispatcher;
+  std::wstring pooledId; // Key in the pool for controllers from VolumeControl.open()
+  size_t poolReferences = 0;
+
+  explicit VolumeControlWrapper(const std::wstring& deviceId) : device(new VolumeControl(deviceId))
+  {
+    live()++;
+  }
+
+  ~VolumeControlWrapper()
+  {
+    release();
+  }
+
+  // Controllers handed out by VolumeControl.open(), by endpoint id. Pooled wrappers hold a
+  // reference to themselves until their last dispose().
+  static std::unordered_map<std::wstring, VolumeControlWrapper*>& pool()
+  {
+    static std::unordered_map<std::wstring, VolumeControlWrapper*> controllers;
+    return controllers;
+  }
+
+  static size_t& live()
+  {
+    static size_t count = 0;
+    return count;
+  }
+
+  // Unregisters the notifications and drops the COM references right away instead of at the next GC
+  void release()
+  {
+    if (device)
+    {
+      dispatcher.reset();
+      device.reset();
+      live()--;
+    }
+  }
+
+  // Sessions are passed either as a session instance id string or as a handle from getSessions()
+  static uint32_t sessionArgument(VolumeControl& device, v8::Local<v8::Value> value)
+  {
+    if (value->IsNumber())
+    {
+      return Nan::To<uint32_t>(value).FromJust();
+    }
+    if (value->IsString())
+    {
+      return device.sessionHandle(toWideString(value));
+    }
+    throw std::string("The session must be a session id or a session handle.");
+  }
 
   static NAN_METHOD(New)
   {
@@ -135,7 +482,7 @@ private:
       std::cout << "Constructing new object" << std::endl;
       try
       {
-        auto obj = new VolumeControlWrapper();
+        auto obj = new VolumeControlWrapper(deviceArgument(info[0]));
         obj->Wrap(info.This());
         info.GetReturnValue().Set(info.This());
         std::cout << "Constructed new object" << std::endl;
@@ -151,12 +498,79 @@ private:
     }
   }
 
+  // VolumeControl.open(device?): the pooled controller of the endpoint, created on first use. Every
+  // open() needs a dispose(), the native controller goes away with the last one.
+  static NAN_METHOD(Open)
+  {
+    try
+    {
+      std::wstring id = deviceArgument(info[0]);
+      if (id.empty())
+      {
+        id = DefaultDeviceCache::shared().defaultId(eRender, eConsole);
+      }
+      auto found = pool().find(id);
+      if (found != pool().end())
+      {
+        found->second->poolReferences++;
+        info.GetReturnValue().Set(found->second->handle());
+        return;
+      }
+
+      JsStringBatch strings(1);
+      strings.add(id);
+      strings.build();
+      v8::Local<v8::Value> argv[] = {strings[0]};
+      v8::Local<v8::Object> instance;
+      if (!Nan::NewInstance(Nan::New(constructor()), 1, argv).ToLocal(&instance))
+      {
+        return; // The constructor threw
+      }
+      auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(instance);
+      obj->pooledId = id;
+      obj->poolReferences = 1;
+      obj->Ref();
+      pool()[id] = obj;
+      info.GetReturnValue().Set(instance);
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  // Releases the native controller now, later calls throw. A pooled controller is only released by
+  // the dispose() matching its last open(). Disposing twice does nothing.
+  static NAN_METHOD(Dispose)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return;
+    }
+    if (!obj->pooledId.empty())
+    {
+      if (--obj->poolReferences > 0)
+      {
+        return;
+      }
+      pool().erase(obj->pooledId);
+      obj->pooledId.clear();
+      obj->Unref();
+    }
+    obj->release();
+  }
+
   static NAN_METHOD(GetVolume)
   {
     auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
     try
     {
-      info.GetReturnValue().Set(obj->device.getVolume());
+      info.GetReturnValue().Set(obj->device->getVolume());
     }
     catch (std::string e)
     {
@@ -173,9 +587,13 @@ private:
 
     double volume = Nan::To<double>(info[0]).ToChecked();
     auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
     try
     {
-      obj->device.setVolume(volume);
+      obj->device->setVolume(volume);
     }
     catch (std::string e)
     {
@@ -186,9 +604,13 @@ private:
   static NAN_METHOD(IsMuted)
   {
     auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
     try
     {
-      info.GetReturnValue().Set(obj->device.isMuted());
+      info.GetReturnValue().Set(obj->device->isMuted());
     }
     catch (std::string e)
     {
@@ -205,9 +627,13 @@ private:
 
     bool muted = Nan::To<bool>(info[0]).ToChecked();
     auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
     try
     {
-      obj->device.setMuted(muted);
+      obj->device->setMuted(muted);
     }
     catch (std::string e)
     {
@@ -215,23 +641,1588 @@ private:
     }
   }
 
-  static inline Nan::Persistent<v8::Function>& constructor()
+  static NAN_METHOD(GetSessions)
   {
-    static Nan::Persistent<v8::Function> constructorFunction;
-    return constructorFunction;
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    try
+    {
+      std::vector<AudioSession> sessions = obj->device->getSessions();
+
+      JsStringBatch strings(sessions.size() * 2);
+      for (const AudioSession& session : sessions)
+      {
+        strings.add(session.name, InternPool::Sessions);
+        strings.add(session.id, InternPool::Sessions);
+      }
+      strings.build();
+      JsStringInterner::shared().sweep(InternPool::Sessions);
+
+      auto result = Nan::New<v8::Array>(static_cast<int>(sessions.size()));
+      for (size_t i = 0; i < sessions.size(); i++)
+      {
+        const AudioSession& session = sessions[i];
+        auto item = Nan::New<v8::Object>();
+        Nan::Set(item, Nan::New("handle").ToLocalChecked(), Nan::New<v8::Uint32>(session.handle));
+        Nan::Set(item, Nan::New("id").ToLocalChecked(), strings[i * 2 + 1]);
+        Nan::Set(item, Nan::New("pid").ToLocalChecked(), Nan::New<v8::Uint32>(static_cast<uint32_t>(session.pid)));
+        Nan::Set(item, Nan::New("name").ToLocalChecked(), strings[i * 2]);
+        Nan::Set(item, Nan::New("volume").ToLocalChecked(), Nan::New(session.volume));
+        Nan::Set(item, Nan::New("muted").ToLocalChecked(), Nan::New(session.muted != FALSE));
+        Nan::Set(item, Nan::New("state").ToLocalChecked(), Nan::New(sessionStateName(session.state)).ToLocalChecked());
+        Nan::Set(item, Nan::New("systemSounds").ToLocalChecked(), Nan::New(session.systemSounds));
+        Nan::Set(result, static_cast<uint32_t>(i), item);
+      }
+      info.GetReturnValue().Set(result);
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
   }
-};
 
-void UnInitialize(void*)
-{
-  CoUninitialize();
-}
+  static NAN_METHOD(GetSessionVolume)
+  {
+    if (info.Length() != 1)
+    {
+      return Nan::ThrowError(Nan::New("Exactly one session parameter is required.").ToLocalChecked());
+    }
 
-NAN_MODULE_INIT(InitModule)
-{
-  CoInitialize(NULL);
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    try
+    {
+      info.GetReturnValue().Set(obj->device->getSessionVolume(sessionArgument(*obj->device, info[0])));
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
 
-  VolumeControlWrapper::Init(target);
+  static NAN_METHOD(SetSessionVolume)
+  {
+    if (info.Length() != 2)
+    {
+      return Nan::ThrowError(Nan::New("A session and a number parameter are required.").ToLocalChecked());
+    }
+
+    double volume = Nan::To<double>(info[1]).ToChecked();
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    try
+    {
+      obj->device->setSessionVolume(sessionArgument(*obj->device, info[0]), volume);
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  static NAN_METHOD(IsSessionMuted)
+  {
+    if (info.Length() != 1)
+    {
+      return Nan::ThrowError(Nan::New("Exactly one session parameter is required.").ToLocalChecked());
+    }
+
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    try
+    {
+      info.GetReturnValue().Set(obj->device->isSessionMuted(sessionArgument(*obj->device, info[0])) != FALSE);
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  static NAN_METHOD(SetSessionMuted)
+  {
+    if (info.Length() != 2)
+    {
+      return Nan::ThrowError(Nan::New("A session and a boolean parameter are required.").ToLocalChecked());
+    }
+
+    bool muted = Nan::To<bool>(info[1]).ToChecked();
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    try
+    {
+      obj->device->setSessionMuted(sessionArgument(*obj->device, info[0]), muted);
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  // Copies of the native session columns, indexed by slot: { handles, volumes, muted, states, flags }
+  static NAN_METHOD(GetSessionTable)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    const SessionStateTable& table = obj->device->sessionTable();
+    size_t count = table.size();
+
+    auto result = Nan::New<v8::Object>();
+    Nan::Set(result, Nan::New("handles").ToLocalChecked(), toTypedArray<v8::Uint32Array>(table.handleColumn(), count));
+    Nan::Set(result, Nan::New("volumes").ToLocalChecked(), toTypedArray<v8::Float32Array>(table.volumeColumn(), count));
+    Nan::Set(result, Nan::New("muted").ToLocalChecked(), toTypedArray<v8::Uint8Array>(table.mutedColumn(), count));
+    Nan::Set(result, Nan::New("states").ToLocalChecked(), toTypedArray<v8::Uint8Array>(table.stateColumn(), count));
+    Nan::Set(result, Nan::New("flags").ToLocalChecked(), toTypedArray<v8::Uint8Array>(table.flagColumn(), count));
+    info.GetReturnValue().Set(result);
+  }
+
+  static NAN_METHOD(ScaleSessionVolumes)
+  {
+    if (info.Length() != 1)
+    {
+      return Nan::ThrowError(Nan::New("Exactly one number parameter is required.").ToLocalChecked());
+    }
+
+    double factor = Nan::To<double>(info[0]).ToChecked();
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    try
+    {
+      info.GetReturnValue().Set(static_cast<uint32_t>(obj->device->scaleSessionVolumes(static_cast<float>(factor))));
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  static NAN_METHOD(SetSessionsMuted)
+  {
+    if (info.Length() < 1 || info.Length() > 2)
+    {
+      return Nan::ThrowError(Nan::New("A boolean and an optional session parameter are required.").ToLocalChecked());
+    }
+
+    bool muted = Nan::To<bool>(info[0]).ToChecked();
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    try
+    {
+      uint32_t keep = info[1]->IsUndefined() ? HandleTable<>::invalidHandle : sessionArgument(*obj->device, info[1]);
+      info.GetReturnValue().Set(static_cast<uint32_t>(obj->device->setSessionsMuted(muted, keep)));
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  static NAN_METHOD(Focus)
+  {
+    if (info.Length() != 1 || !(info[0]->IsNumber() || info[0]->IsString()))
+    {
+      return Nan::ThrowError(Nan::New("Exactly one session handle, session id or process name is required.").ToLocalChecked());
+    }
+
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    try
+    {
+      size_t muted = info[0]->IsNumber()
+        ? obj->device->focus(Nan::To<uint32_t>(info[0]).FromJust(), std::wstring())
+        : obj->device->focus(HandleTable<>::invalidHandle, toWideString(info[0]));
+      info.GetReturnValue().Set(static_cast<uint32_t>(muted));
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  static NAN_METHOD(Unfocus)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    try
+    {
+      info.GetReturnValue().Set(static_cast<uint32_t>(obj->device->unfocus()));
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  static NAN_METHOD(IsFocused)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    info.GetReturnValue().Set(obj->device->isFocused());
+  }
+
+  static NAN_METHOD(Undo)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    try
+    {
+      info.GetReturnValue().Set(static_cast<uint32_t>(obj->device->undo()));
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  static NAN_METHOD(Redo)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    try
+    {
+      info.GetReturnValue().Set(static_cast<uint32_t>(obj->device->redo()));
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  static NAN_METHOD(CanUndo)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    info.GetReturnValue().Set(obj->device->canUndo());
+  }
+
+  static NAN_METHOD(CanRedo)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    info.GetReturnValue().Set(obj->device->canRedo());
+  }
+
+  // Options: { session?, from?, to?, resolution?: 'raw' | 'second' | 'minute' }, defaulting to the
+  // device over the last 24 hours at minute resolution
+  static NAN_METHOD(GetVolumeHistory)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    try
+    {
+      uint64_t to = unixTimeMs();
+      uint64_t from = to - 24 * 60 * 60 * 1000;
+      uint32_t session = HandleTable<>::invalidHandle;
+      VolumeHistory::Resolution resolution = VolumeHistory::Resolution::Minute;
+
+      if (info[0]->IsObject())
+      {
+        auto options = info[0].As<v8::Object>();
+        auto sessionOption = Nan::Get(options, Nan::New("session").ToLocalChecked()).ToLocalChecked();
+        auto fromOption = Nan::Get(options, Nan::New("from").ToLocalChecked()).ToLocalChecked();
+        auto toOption = Nan::Get(options, Nan::New("to").ToLocalChecked()).ToLocalChecked();
+        auto resolutionOption = Nan::Get(options, Nan::New("resolution").ToLocalChecked()).ToLocalChecked();
+
+        if (!sessionOption->IsUndefined())
+        {
+          session = sessionArgument(*obj->device, sessionOption);
+        }
+        if (fromOption->IsNumber())
+        {
+          from = static_cast<uint64_t>(Nan::To<double>(fromOption).FromJust());
+        }
+        if (toOption->IsNumber())
+        {
+          to = static_cast<uint64_t>(Nan::To<double>(toOption).FromJust());
+        }
+        if (resolutionOption->IsString())
+        {
+          std::string name = *Nan::Utf8String(resolutionOption);
+          if (name == "raw")
+          {
+            resolution = VolumeHistory::Resolution::Raw;
+          }
+          else if (name == "second")
+          {
+            resolution = VolumeHistory::Resolution::Second;
+          }
+          else if (name != "minute")
+          {
+            throw std::string("The resolution must be 'raw', 'second' or 'minute'.");
+          }
+        }
+      }
+
+      VolumeHistory::Range range = obj->device->volumeHistory(session, from, to, resolution);
+      size_t count = range.times.size();
+      auto result = Nan::New<v8::Object>();
+      Nan::Set(result, Nan::New("times").ToLocalChecked(), toTypedArray<v8::Float64Array>(range.times.data(), count));
+      Nan::Set(result, Nan::New("min").ToLocalChecked(), toTypedArray<v8::Float32Array>(range.minimum.data(), count));
+      Nan::Set(result, Nan::New("max").ToLocalChecked(), toTypedArray<v8::Float32Array>(range.maximum.data(), count));
+      Nan::Set(result, Nan::New("last").ToLocalChecked(), toTypedArray<v8::Float32Array>(range.last.data(), count));
+      Nan::Set(result, Nan::New("muted").ToLocalChecked(), toTypedArray<v8::Uint8Array>(range.muted.data(), count));
+      info.GetReturnValue().Set(result);
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  // Options: { interval?, capacity? }, sampling every 50 ms into 65536 samples, about 55 minutes
+  static NAN_METHOD(StartMetering)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    try
+    {
+      uint32_t interval = 50;
+      uint32_t capacity = 65536;
+      if (info[0]->IsObject())
+      {
+        auto options = info[0].As<v8::Object>();
+        auto intervalOption = Nan::Get(options, Nan::New("interval").ToLocalChecked()).ToLocalChecked();
+        auto capacityOption = Nan::Get(options, Nan::New("capacity").ToLocalChecked()).ToLocalChecked();
+        if (intervalOption->IsNumber())
+        {
+          interval = std::max<uint32_t>(1, Nan::To<uint32_t>(intervalOption).FromJust());
+        }
+        if (capacityOption->IsNumber())
+        {
+          capacity = std::max<uint32_t>(MeterHistory::blockSize, Nan::To<uint32_t>(capacityOption).FromJust());
+        }
+      }
+      obj->device->startMetering(interval, capacity);
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  static NAN_METHOD(StopMetering)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    obj->device->stopMetering();
+  }
+
+  static NAN_METHOD(IsMetering)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    info.GetReturnValue().Set(obj->device->isMetering());
+  }
+
+  // Options: { from?, to?, window?, threshold?, percentile? }, defaulting to one window over the
+  // last minute, the 95th percentile and a threshold of 0.1 (-20 dBFS)
+  static NAN_METHOD(QueryMeter)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    try
+    {
+      uint64_t to = unixTimeMs();
+      uint64_t from = to - 60 * 1000;
+      uint64_t window = 0;
+      float threshold = 0.1f;
+      float percentile = 0.95f;
+
+      if (info[0]->IsObject())
+      {
+        auto options = info[0].As<v8::Object>();
+        auto fromOption = Nan::Get(options, Nan::New("from").ToLocalChecked()).ToLocalChecked();
+        auto toOption = Nan::Get(options, Nan::New("to").ToLocalChecked()).ToLocalChecked();
+        auto windowOption = Nan::Get(options, Nan::New("window").ToLocalChecked()).ToLocalChecked();
+        auto thresholdOption = Nan::Get(options, Nan::New("threshold").ToLocalChecked()).ToLocalChecked();
+        auto percentileOption = Nan::Get(options, Nan::New("percentile").ToLocalChecked()).ToLocalChecked();
+
+        if (fromOption->IsNumber())
+        {
+          from = static_cast<uint64_t>(Nan::To<double>(fromOption).FromJust());
+        }
+        if (toOption->IsNumber())
+        {
+          to = static_cast<uint64_t>(Nan::To<double>(toOption).FromJust());
+        }
+        if (windowOption->IsNumber())
+        {
+          window = static_cast<uint64_t>(Nan::To<double>(windowOption).FromJust());
+        }
+        if (thresholdOption->IsNumber())
+        {
+          threshold = static_cast<float>(Nan::To<double>(thresholdOption).FromJust());
+        }
+        if (percentileOption->IsNumber())
+        {
+          percentile = static_cast<float>(Nan::To<double>(percentileOption).FromJust());
+        }
+      }
+      if (from > to)
+      {
+        throw std::string("The range must not end before it starts.");
+      }
+      if (window == 0)
+      {
+        window = to - from + 1;
+      }
+      if ((to - from) / window >= 100000)
+      {
+        throw std::string("The range is split into too many windows.");
+      }
+
+      std::vector<MeterWindow> windows = obj->device->queryMeter(from, to, window, threshold, percentile);
+      size_t count = windows.size();
+      std::vector<double> times(count);
+      std::vector<float> minimum(count);
+      std::vector<float> maximum(count);
+      std::vector<float> average(count);
+      std::vector<float> percentiles(count);
+      std::vector<double> timeAbove(count);
+      std::vector<uint32_t> samples(count);
+      for (size_t i = 0; i < count; i++)
+      {
+        times[i] = static_cast<double>(from + i * window);
+        minimum[i] = windows[i].minimum;
+        maximum[i] = windows[i].maximum;
+        average[i] = windows[i].average;
+        percentiles[i] = windows[i].percentile;
+        timeAbove[i] = windows[i].timeAboveMs;
+        samples[i] = windows[i].count;
+      }
+
+      auto result = Nan::New<v8::Object>();
+      Nan::Set(result, Nan::New("times").ToLocalChecked(), toTypedArray<v8::Float64Array>(times.data(), count));
+      Nan::Set(result, Nan::New("min").ToLocalChecked(), toTypedArray<v8::Float32Array>(minimum.data(), count));
+      Nan::Set(result, Nan::New("max").ToLocalChecked(), toTypedArray<v8::Float32Array>(maximum.data(), count));
+      Nan::Set(result, Nan::New("avg").ToLocalChecked(), toTypedArray<v8::Float32Array>(average.data(), count));
+      Nan::Set(result, Nan::New("percentile").ToLocalChecked(), toTypedArray<v8::Float32Array>(percentiles.data(), count));
+      Nan::Set(result, Nan::New("timeAbove").ToLocalChecked(), toTypedArray<v8::Float64Array>(timeAbove.data(), count));
+      Nan::Set(result, Nan::New("count").ToLocalChecked(), toTypedArray<v8::Uint32Array>(samples.data(), count));
+      info.GetReturnValue().Set(result);
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  // Options: { file?, referenceLevel?, thresholds? }
+  static NAN_METHOD(StartExposureTracking)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    try
+    {
+      ExposureDose::Settings settings;
+      std::wstring file;
+      if (info[0]->IsObject())
+      {
+        auto options = info[0].As<v8::Object>();
+        auto fileOption = Nan::Get(options, Nan::New("file").ToLocalChecked()).ToLocalChecked();
+        auto referenceOption = Nan::Get(options, Nan::New("referenceLevel").ToLocalChecked()).ToLocalChecked();
+        auto thresholdsOption = Nan::Get(options, Nan::New("thresholds").ToLocalChecked()).ToLocalChecked();
+
+        if (fileOption->IsString())
+        {
+          file = toWideString(fileOption);
+        }
+        if (referenceOption->IsNumber())
+        {
+          settings.referenceLevel = Nan::To<double>(referenceOption).FromJust();
+        }
+        if (thresholdsOption->IsArray())
+        {
+          auto thresholds = thresholdsOption.As<v8::Array>();
+          if (thresholds->Length() > 32)
+          {
+            throw std::string("At most 32 thresholds are supported.");
+          }
+          settings.thresholds.clear();
+          for (uint32_t i = 0; i < thresholds->Length(); i++)
+          {
+            settings.thresholds.push_back(Nan::To<double>(Nan::Get(thresholds, i).ToLocalChecked()).FromJust());
+          }
+        }
+      }
+      obj->device->startExposureTracking(settings, file);
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  static NAN_METHOD(StopExposureTracking)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    obj->device->stopExposureTracking();
+  }
+
+  static NAN_METHOD(GetExposure)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    try
+    {
+      ExposureDose& exposure = obj->device->exposureDose();
+      auto result = Nan::New<v8::Object>();
+      Nan::Set(result, Nan::New("dose").ToLocalChecked(), Nan::New(exposure.dose(localDay(unixTimeMs()))));
+      Nan::Set(result, Nan::New("level").ToLocalChecked(), Nan::New(exposure.level()));
+      info.GetReturnValue().Set(result);
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  // Options: { threshold?, hold?, maxInterval? }, null turns detection off
+  static NAN_METHOD(SetSilenceDetection)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    try
+    {
+      SilenceDetector::Settings settings;
+      bool enabled = !info[0]->IsNull() && !info[0]->IsFalse();
+      if (info[0]->IsObject())
+      {
+        auto options = info[0].As<v8::Object>();
+        auto thresholdOption = Nan::Get(options, Nan::New("threshold").ToLocalChecked()).ToLocalChecked();
+        auto holdOption = Nan::Get(options, Nan::New("hold").ToLocalChecked()).ToLocalChecked();
+        auto maxIntervalOption = Nan::Get(options, Nan::New("maxInterval").ToLocalChecked()).ToLocalChecked();
+
+        if (thresholdOption->IsNumber())
+        {
+          settings.threshold = static_cast<float>(Nan::To<double>(thresholdOption).FromJust());
+        }
+        if (holdOption->IsNumber())
+        {
+          settings.holdMs = static_cast<uint64_t>(Nan::To<double>(holdOption).FromJust());
+        }
+        if (maxIntervalOption->IsNumber())
+        {
+          settings.maxIntervalMs = Nan::To<uint32_t>(maxIntervalOption).FromJust();
+        }
+      }
+      obj->device->setSilenceDetection(enabled, settings);
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  static NAN_METHOD(IsSilent)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    info.GetReturnValue().Set(obj->device->isSilent());
+  }
+
+  // Options: { autoMute?, attack?, release?, margin?, flatness? }
+  static NAN_METHOD(StartVoiceDetection)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    try
+    {
+      VoiceActivityDetector::Settings settings;
+      bool autoMute = false;
+      if (info[0]->IsObject())
+      {
+        auto options = info[0].As<v8::Object>();
+        auto autoMuteOption = Nan::Get(options, Nan::New("autoMute").ToLocalChecked()).ToLocalChecked();
+        auto attackOption = Nan::Get(options, Nan::New("attack").ToLocalChecked()).ToLocalChecked();
+        auto releaseOption = Nan::Get(options, Nan::New("release").ToLocalChecked()).ToLocalChecked();
+        auto marginOption = Nan::Get(options, Nan::New("margin").ToLocalChecked()).ToLocalChecked();
+        auto flatnessOption = Nan::Get(options, Nan::New("flatness").ToLocalChecked()).ToLocalChecked();
+
+        autoMute = autoMuteOption->IsTrue();
+        if (attackOption->IsNumber())
+        {
+          settings.attackMs = Nan::To<uint32_t>(attackOption).FromJust();
+        }
+        if (releaseOption->IsNumber())
+        {
+          settings.releaseMs = Nan::To<uint32_t>(releaseOption).FromJust();
+        }
+        if (marginOption->IsNumber())
+        {
+          settings.marginDb = Nan::To<double>(marginOption).FromJust();
+        }
+        if (flatnessOption->IsNumber())
+        {
+          settings.flatness = Nan::To<double>(flatnessOption).FromJust();
+        }
+      }
+      obj->device->startVoiceDetection(settings, autoMute);
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  static NAN_METHOD(StopVoiceDetection)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    obj->device->stopVoiceDetection();
+  }
+
+  static NAN_METHOD(IsSpeaking)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    info.GetReturnValue().Set(obj->device->isSpeaking());
+  }
+
+  // joinLease({ priority, controls }), `controls` lists 'volume' and 'mute', both when omitted
+  static NAN_METHOD(JoinLease)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    try
+    {
+      uint32_t controls = (1u << static_cast<uint32_t>(LeaseControl::Volume)) | (1u << static_cast<uint32_t>(LeaseControl::Mute));
+      uint32_t priority = 0;
+      if (info[0]->IsObject())
+      {
+        auto options = info[0].As<v8::Object>();
+        auto priorityOption = Nan::Get(options, Nan::New("priority").ToLocalChecked()).ToLocalChecked();
+        auto controlsOption = Nan::Get(options, Nan::New("controls").ToLocalChecked()).ToLocalChecked();
+        if (priorityOption->IsNumber())
+        {
+          priority = Nan::To<uint32_t>(priorityOption).FromJust();
+        }
+        if (controlsOption->IsArray())
+        {
+          auto list = controlsOption.As<v8::Array>();
+          controls = 0;
+          for (uint32_t i = 0; i < list->Length(); i++)
+          {
+            controls |= 1u << static_cast<uint32_t>(leaseControlArgument(Nan::Get(list, i).ToLocalChecked()));
+          }
+        }
+      }
+      if (priority > 65535)
+      {
+        throw std::string("The priority must be between 0 and 65535.");
+      }
+      obj->device->joinLease(controls, static_cast<uint16_t>(priority));
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  static NAN_METHOD(LeaveLease)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    obj->device->leaveLease();
+  }
+
+  // Whether this process may write the control now, always true outside a lease
+  static NAN_METHOD(HoldsLease)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    try
+    {
+      info.GetReturnValue().Set(obj->device->mayWrite(leaseControlArgument(info[0])));
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  static NAN_METHOD(GetLeaseOwner)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    try
+    {
+      info.GetReturnValue().Set(obj->device->leaseOwner(leaseControlArgument(info[0])));
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  // Returns the segment name, readers open it with new SharedState(deviceId)
+  static NAN_METHOD(StartPublishing)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    try
+    {
+      std::wstring name = obj->device->startPublishing(); // The batch reads the string when building
+      JsStringBatch strings(1);
+      strings.add(name);
+      strings.build();
+      info.GetReturnValue().Set(strings[0]);
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  static NAN_METHOD(StopPublishing)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    obj->device->stopPublishing();
+  }
+
+  static NAN_METHOD(IsPublishing)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    info.GetReturnValue().Set(obj->device->isPublishing());
+  }
+
+  // setEventHandler(handler, batchHandler?): one handler per controller, null removes it. While
+  // events wait too long for the loop, they go to `batchHandler` packed into one Float64Array.
+  static NAN_METHOD(SetEventHandler)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    if (!info[0]->IsFunction() && !info[0]->IsNull())
+    {
+      return Nan::ThrowError(Nan::New("The event handler must be a function or null.").ToLocalChecked());
+    }
+    if (!info[1]->IsUndefined() && !info[1]->IsFunction())
+    {
+      return Nan::ThrowError(Nan::New("The batch handler must be a function.").ToLocalChecked());
+    }
+    obj->dispatcher.reset();
+    if (info[0]->IsFunction())
+    {
+      auto handler = std::make_shared<Nan::Callback>(info[0].As<v8::Function>());
+      auto resource = std::make_shared<Nan::AsyncResource>("node-audio-windows:events");
+      JsEventDispatcher::BatchSink batchSink;
+      if (info[1]->IsFunction())
+      {
+        auto batchHandler = std::make_shared<Nan::Callback>(info[1].As<v8::Function>());
+        batchSink = [batchHandler, resource](const std::vector<AudioEvent>& events) {
+          v8::Local<v8::Value> argv[] = {toPackedEvents(events)};
+          batchHandler->Call(1, argv, resource.get());
+        };
+      }
+      obj->dispatcher.reset(new JsEventDispatcher(obj->device->events(), [handler, resource](const AudioEvent& event) {
+        v8::Local<v8::Value> argv[] = {toJsEvent(event)};
+        handler->Call(1, argv, resource.get());
+      }, batchSink));
+    }
+  }
+
+  // Pull mode for the async iterator in index.js: `signal` runs when events are waiting, which
+  // readEvents() then takes at the consumer's pace. Replaces the event handler and vice versa.
+  static NAN_METHOD(SetEventSignal)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    if (!info[0]->IsFunction() && !info[0]->IsNull())
+    {
+      return Nan::ThrowError(Nan::New("The event signal must be a function or null.").ToLocalChecked());
+    }
+    obj->dispatcher.reset();
+    if (info[0]->IsFunction())
+    {
+      auto signal = std::make_shared<Nan::Callback>(info[0].As<v8::Function>());
+      auto resource = std::make_shared<Nan::AsyncResource>("node-audio-windows:events");
+      obj->dispatcher.reset(new JsEventDispatcher(obj->device->events(), [signal, resource]() {
+        signal->Call(0, NULL, resource.get());
+      }));
+    }
+  }
+
+  // readEvents(max?): the oldest waiting events, at most `max`
+  static NAN_METHOD(ReadEvents)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    size_t max = info[0]->IsNumber() ? Nan::To<uint32_t>(info[0]).FromJust() : SIZE_MAX;
+    std::vector<AudioEvent> events = obj->device->events()->drain(max);
+    auto result = Nan::New<v8::Array>(static_cast<int>(events.size()));
+    for (size_t i = 0; i < events.size(); i++)
+    {
+      Nan::Set(result, static_cast<uint32_t>(i), toJsEvent(events[i]));
+    }
+    info.GetReturnValue().Set(result);
+  }
+
+  static NAN_METHOD(SetEventCapacity)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    if (!info[0]->IsNumber())
+    {
+      return Nan::ThrowError(Nan::New("The capacity must be a number.").ToLocalChecked());
+    }
+    obj->device->events()->setCapacity(Nan::To<uint32_t>(info[0]).FromJust());
+  }
+
+  static NAN_METHOD(GetEventStats)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    EventQueue::Stats stats = obj->device->events()->stats();
+    auto result = Nan::New<v8::Object>();
+    Nan::Set(result, Nan::New("queued").ToLocalChecked(), Nan::New(static_cast<double>(stats.queued)));
+    Nan::Set(result, Nan::New("capacity").ToLocalChecked(), Nan::New(static_cast<double>(stats.capacity)));
+    Nan::Set(result, Nan::New("delivered").ToLocalChecked(), Nan::New(static_cast<double>(stats.delivered)));
+    Nan::Set(result, Nan::New("dropped").ToLocalChecked(), Nan::New(static_cast<double>(stats.dropped)));
+    Nan::Set(result, Nan::New("coalesced").ToLocalChecked(), Nan::New(static_cast<double>(stats.coalesced)));
+    Nan::Set(result, Nan::New("latencyMs").ToLocalChecked(), Nan::New(stats.latencyMs));
+    Nan::Set(result, Nan::New("lagging").ToLocalChecked(), Nan::New(stats.lagging));
+    info.GetReturnValue().Set(result);
+  }
+
+  // { getVolume: { calls, failures, totalMs }, ... }, null unless built with audio_call_stats=1
+  static NAN_METHOD(GetCallStats)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<VolumeControlWrapper>(info.Holder());
+    if (!obj->device)
+    {
+      return Nan::ThrowError(Nan::New("The controller has been disposed.").ToLocalChecked());
+    }
+    if (!VolumeControl::countsCalls)
+    {
+      info.GetReturnValue().SetNull();
+      return;
+    }
+    CallStats stats = obj->device->callStats();
+    auto result = Nan::New<v8::Object>();
+    for (size_t call = 0; call < controlCalls; call++)
+    {
+      auto entry = Nan::New<v8::Object>();
+      Nan::Set(entry, Nan::New("calls").ToLocalChecked(), Nan::New(static_cast<double>(stats.calls[call])));
+      Nan::Set(entry, Nan::New("failures").ToLocalChecked(), Nan::New(static_cast<double>(stats.failures[call])));
+      Nan::Set(entry, Nan::New("totalMs").ToLocalChecked(), Nan::New(stats.micros[call] / 1000.0));
+      Nan::Set(result, Nan::New(controlCallName(static_cast<ControlCall>(call))).ToLocalChecked(), entry);
+    }
+    info.GetReturnValue().Set(result);
+  }
+
+  static inline Nan::Persistent<v8::Function>& constructor()
+  {
+    static Nan::Persistent<v8::Function> constructorFunction;
+    return constructorFunction;
+  }
+};
+
+// JS side of MicrophoneMute. Requests take a node style callback, index.js turns them into
+// promises. The object stays alive while requests are outstanding.
+class MicrophoneMuteWrapper : public Nan::ObjectWrap
+{
+public:
+  static NAN_MODULE_INIT(Init)
+  {
+    auto tpl = Nan::New<v8::FunctionTemplate>(New);
+    tpl->SetClassName(Nan::New("MicrophoneMute").ToLocalChecked());
+    tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+    Nan::SetPrototypeMethod(tpl, "requestMute", RequestMute);
+    Nan::SetPrototypeMethod(tpl, "isMuted", IsMuted);
+    Nan::SetPrototypeMethod(tpl, "getLatencyStats", GetLatencyStats);
+    Nan::SetPrototypeMethod(tpl, "close", Close);
+
+    Nan::Set(target, Nan::New("MicrophoneMute").ToLocalChecked(), Nan::GetFunction(tpl).ToLocalChecked());
+  }
+
+private:
+  // Every request completes with one event, so a queue of this size never drops a completion
+  static const size_t maxOutstanding = 1024;
+
+  std::shared_ptr<EventQueue> completions = std::make_shared<EventQueue>(maxOutstanding);
+  std::unordered_map<uint32_t, std::unique_ptr<Nan::Callback>> callbacks;
+  Nan::AsyncResource resource;
+  std::unique_ptr<JsEventDispatcher> dispatcher;
+  std::unique_ptr<MicrophoneMute> microphone; // Declared last, its thread stops first
+
+  explicit MicrophoneMuteWrapper(const std::wstring& deviceId) : resource("node-audio-windows:microphoneMute")
+  {
+    dispatcher.reset(new JsEventDispatcher(completions, [this](const AudioEvent& event) { complete(event); }));
+    microphone.reset(new MicrophoneMute(deviceId, completions));
+  }
+
+  MicrophoneMute& open()
+  {
+    if (!microphone)
+    {
+      throw std::string("The microphone has been closed.");
+    }
+    return *microphone;
+  }
+
+  void complete(const AudioEvent& event)
+  {
+    auto found = callbacks.find(event.target);
+    if (found == callbacks.end())
+    {
+      return;
+    }
+    std::unique_ptr<Nan::Callback> callback = std::move(found->second);
+    callbacks.erase(found);
+    settle();
+
+    v8::Local<v8::Value> argv[2];
+    if (event.type == AudioEventType::MuteConfirmed)
+    {
+      auto result = Nan::New<v8::Object>();
+      Nan::Set(result, Nan::New("muted").ToLocalChecked(), Nan::New(event.detail != 0));
+      Nan::Set(result, Nan::New("latency").ToLocalChecked(), Nan::New(event.value));
+      argv[0] = Nan::Null();
+      argv[1] = result;
+    }
+    else
+    {
+      argv[0] = Nan::Error("The microphone did not confirm the mute change.");
+      argv[1] = Nan::Undefined();
+    }
+    callback->Call(2, argv, &resource);
+  }
+
+  // Balances the Ref() taken by the first outstanding request
+  void settle()
+  {
+    if (callbacks.empty())
+    {
+      dispatcher->keepAlive(false);
+      Unref();
+    }
+  }
+
+  static NAN_METHOD(New)
+  {
+    if (!info.IsConstructCall())
+    {
+      return Nan::ThrowError(Nan::New("The constructor cannot be called as a function.").ToLocalChecked());
+    }
+    try
+    {
+      auto obj = new MicrophoneMuteWrapper(deviceArgument(info[0]));
+      obj->Wrap(info.This());
+      info.GetReturnValue().Set(info.This());
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  // requestMute(muted | 'toggle', callback)
+  static NAN_METHOD(RequestMute)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<MicrophoneMuteWrapper>(info.Holder());
+    try
+    {
+      if (!info[1]->IsFunction())
+      {
+        throw std::string("A completion callback is required.");
+      }
+      MicrophoneMute::Command command = MicrophoneMute::Command::Toggle;
+      if (info[0]->IsBoolean())
+      {
+        command = info[0]->IsTrue() ? MicrophoneMute::Command::Mute : MicrophoneMute::Command::Unmute;
+      }
+      else if (!info[0]->IsString() || std::string(*Nan::Utf8String(info[0])) != "toggle")
+      {
+        throw std::string("The state must be a boolean or 'toggle'.");
+      }
+      if (obj->callbacks.size() >= maxOutstanding)
+      {
+        throw std::string("Too many mute requests are waiting for confirmation.");
+      }
+
+      uint32_t id = obj->open().request(command);
+      if (obj->callbacks.empty())
+      {
+        obj->Ref();
+        obj->dispatcher->keepAlive(true);
+      }
+      obj->callbacks[id].reset(new Nan::Callback(info[1].As<v8::Function>()));
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  static NAN_METHOD(IsMuted)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<MicrophoneMuteWrapper>(info.Holder());
+    try
+    {
+      info.GetReturnValue().Set(obj->open().isMuted());
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  // Request to confirmation latencies in ms, with the histogram buckets holding any
+  static NAN_METHOD(GetLatencyStats)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<MicrophoneMuteWrapper>(info.Holder());
+    try
+    {
+      const LatencyHistogram& latencies = obj->open().latencies();
+      LatencyHistogram::Snapshot snapshot = latencies.snapshot();
+      std::vector<double> bounds;
+      std::vector<double> counts;
+      for (size_t bucket = 0; bucket < LatencyHistogram::bucketCount; bucket++)
+      {
+        if (snapshot.counts[bucket] != 0)
+        {
+          bounds.push_back(LatencyHistogram::upperBound(bucket) / 1000.0);
+          counts.push_back(static_cast<double>(snapshot.counts[bucket]));
+        }
+      }
+
+      auto result = Nan::New<v8::Object>();
+      Nan::Set(result, Nan::New("count").ToLocalChecked(), Nan::New(static_cast<double>(snapshot.total)));
+      Nan::Set(result, Nan::New("min").ToLocalChecked(), Nan::New(snapshot.minimum / 1000.0));
+      Nan::Set(result, Nan::New("max").ToLocalChecked(), Nan::New(snapshot.maximum / 1000.0));
+      Nan::Set(result, Nan::New("mean").ToLocalChecked(), Nan::New(snapshot.total != 0 ? snapshot.sum / 1000.0 / snapshot.total : 0.0));
+      Nan::Set(result, Nan::New("p50").ToLocalChecked(), Nan::New(latencies.percentile(0.5) / 1000.0));
+      Nan::Set(result, Nan::New("p90").ToLocalChecked(), Nan::New(latencies.percentile(0.9) / 1000.0));
+      Nan::Set(result, Nan::New("p99").ToLocalChecked(), Nan::New(latencies.percentile(0.99) / 1000.0));
+      Nan::Set(result, Nan::New("bounds").ToLocalChecked(), toTypedArray<v8::Float64Array>(bounds.data(), bounds.size()));
+      Nan::Set(result, Nan::New("counts").ToLocalChecked(), toTypedArray<v8::Float64Array>(counts.data(), counts.size()));
+      info.GetReturnValue().Set(result);
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  // Stops the worker, outstanding requests fail
+  static NAN_METHOD(Close)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<MicrophoneMuteWrapper>(info.Holder());
+    if (!obj->microphone)
+    {
+      return;
+    }
+    obj->microphone.reset();
+
+    // Changes Windows confirmed before the thread stopped did happen, only the rest fail
+    for (const AudioEvent& event : obj->completions->drain())
+    {
+      obj->complete(event);
+    }
+
+    std::vector<uint32_t> outstanding;
+    for (const auto& entry : obj->callbacks)
+    {
+      outstanding.push_back(entry.first);
+    }
+    for (uint32_t id : outstanding)
+    {
+      obj->complete(AudioEvent{AudioEventType::MuteFailed, unixTimeMs(), id, 0, 0});
+    }
+  }
+};
+
+// State another process publishes with startPublishing(), read from shared memory without COM
+class SharedStateWrapper : public Nan::ObjectWrap
+{
+public:
+  static NAN_MODULE_INIT(Init)
+  {
+    auto tpl = Nan::New<v8::FunctionTemplate>(New);
+    tpl->SetClassName(Nan::New("SharedState").ToLocalChecked());
+    tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+    Nan::SetPrototypeMethod(tpl, "read", Read);
+    Nan::SetPrototypeMethod(tpl, "getVersion", GetVersion);
+    Nan::SetPrototypeMethod(tpl, "close", Close);
+
+    Nan::Set(target, Nan::New("SharedState").ToLocalChecked(), Nan::GetFunction(tpl).ToLocalChecked());
+  }
+
+private:
+  std::unique_ptr<PublishedStateReader> reader;
+
+  explicit SharedStateWrapper(const std::wstring& name) : reader(new PublishedStateReader(name))
+  {
+  }
+
+  PublishedStateReader& open()
+  {
+    if (!reader)
+    {
+      throw std::string("The shared state has been closed.");
+    }
+    return *reader;
+  }
+
+  // new SharedState(device?), the default render device when omitted
+  static NAN_METHOD(New)
+  {
+    if (!info.IsConstructCall())
+    {
+      return Nan::ThrowError(Nan::New("The constructor cannot be called as a function.").ToLocalChecked());
+    }
+    try
+    {
+      std::wstring id = deviceArgument(info[0]);
+      if (id.empty())
+      {
+        id = DefaultDeviceCache::shared().defaultId(eRender, eConsole);
+      }
+      auto obj = new SharedStateWrapper(publishedStateName(id));
+      obj->Wrap(info.This());
+      info.GetReturnValue().Set(info.This());
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  // A consistent copy of the state, null until the publisher has written one
+  static NAN_METHOD(Read)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<SharedStateWrapper>(info.Holder());
+    try
+    {
+      PublishedSnapshot snapshot;
+      if (!obj->open().read(snapshot))
+      {
+        info.GetReturnValue().SetNull();
+        return;
+      }
+
+      auto sessions = Nan::New<v8::Array>();
+      uint32_t count = 0;
+      uint32_t slots = snapshot.sessionCount < PublishedSnapshot::maxSessions ? snapshot.sessionCount : PublishedSnapshot::maxSessions;
+      for (uint32_t i = 0; i < slots; i++)
+      {
+        const PublishedSession& session = snapshot.sessions[i];
+        if (!(session.flags & SessionStateTable::Live))
+        {
+          continue;
+        }
+        auto item = Nan::New<v8::Object>();
+        Nan::Set(item, Nan::New("handle").ToLocalChecked(), Nan::New(session.handle));
+        Nan::Set(item, Nan::New("pid").ToLocalChecked(), Nan::New(session.pid));
+        Nan::Set(item, Nan::New("volume").ToLocalChecked(), Nan::New(session.volume));
+        Nan::Set(item, Nan::New("muted").ToLocalChecked(), Nan::New(session.muted != 0));
+        Nan::Set(item, Nan::New("state").ToLocalChecked(), Nan::New(sessionStateName(static_cast<AudioSessionState>(session.state))).ToLocalChecked());
+        Nan::Set(item, Nan::New("systemSounds").ToLocalChecked(), Nan::New((session.flags & SessionStateTable::SystemSounds) != 0));
+        Nan::Set(sessions, count++, item);
+      }
+
+      auto result = Nan::New<v8::Object>();
+      Nan::Set(result, Nan::New("publisherPid").ToLocalChecked(), Nan::New(snapshot.publisherPid));
+      Nan::Set(result, Nan::New("updated").ToLocalChecked(), Nan::New(static_cast<double>(snapshot.updated)));
+      Nan::Set(result, Nan::New("volume").ToLocalChecked(), Nan::New(snapshot.volume));
+      Nan::Set(result, Nan::New("muted").ToLocalChecked(), Nan::New(snapshot.muted != 0));
+      Nan::Set(result, Nan::New("sessions").ToLocalChecked(), sessions);
+      info.GetReturnValue().Set(result);
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  // Changes with every write, so polling readers can skip read() while it stays the same
+  static NAN_METHOD(GetVersion)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<SharedStateWrapper>(info.Holder());
+    try
+    {
+      info.GetReturnValue().Set(obj->open().version());
+    }
+    catch (std::string e)
+    {
+      return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+    }
+  }
+
+  static NAN_METHOD(Close)
+  {
+    auto obj = Nan::ObjectWrap::Unwrap<SharedStateWrapper>(info.Holder());
+    obj->reader.reset();
+  }
+};
+
+NAN_METHOD(ResolveProcessNames)
+{
+  if (info.Length() != 1 || !info[0]->IsArray())
+  {
+    return Nan::ThrowError(Nan::New("Exactly one array of process ids is required.").ToLocalChecked());
+  }
+
+  auto pidArray = info[0].As<v8::Array>();
+  std::vector<DWORD> pids(pidArray->Length());
+  for (uint32_t i = 0; i < pidArray->Length(); i++)
+  {
+    pids[i] = Nan::To<uint32_t>(Nan::Get(pidArray, i).ToLocalChecked()).FromJust();
+  }
+
+  std::vector<std::wstring> names = ProcessNameCache::shared().resolveAll(pids);
+  JsStringBatch strings(names.size());
+  for (const std::wstring& name : names)
+  {
+    strings.add(name, InternPool::Sessions);
+  }
+  strings.build();
+
+  auto result = Nan::New<v8::Array>(static_cast<int>(names.size()));
+  for (size_t i = 0; i < names.size(); i++)
+  {
+    Nan::Set(result, static_cast<uint32_t>(i), strings[i]);
+  }
+  info.GetReturnValue().Set(result);
+}
+
+NAN_METHOD(GetProcessNameCacheStats)
+{
+  ProcessNameCache::Stats stats = ProcessNameCache::shared().stats();
+  auto result = Nan::New<v8::Object>();
+  Nan::Set(result, Nan::New("hits").ToLocalChecked(), Nan::New(static_cast<double>(stats.hits)));
+  Nan::Set(result, Nan::New("misses").ToLocalChecked(), Nan::New(static_cast<double>(stats.misses)));
+  Nan::Set(result, Nan::New("evictions").ToLocalChecked(), Nan::New(static_cast<double>(stats.evictions)));
+  Nan::Set(result, Nan::New("size").ToLocalChecked(), Nan::New(static_cast<double>(stats.size)));
+  info.GetReturnValue().Set(result);
+}
+
+// Native controllers not yet disposed or collected, and how many of them are pooled
+NAN_METHOD(GetControllerStats)
+{
+  auto result = Nan::New<v8::Object>();
+  Nan::Set(result, Nan::New("live").ToLocalChecked(), Nan::New(static_cast<double>(VolumeControlWrapper::liveCount())));
+  Nan::Set(result, Nan::New("pooled").ToLocalChecked(), Nan::New(static_cast<double>(VolumeControlWrapper::pooledCount())));
+  info.GetReturnValue().Set(result);
+}
+
+// Counters a soak run watches for growth: live native objects by kind, open handles of the process
+// and bytes allocated from the process heap, which the CRT allocates from too
+NAN_METHOD(GetNativeStats)
+{
+  auto objects = Nan::New<v8::Object>();
+  for (size_t kind = 0; kind < nativeObjectKinds; kind++)
+  {
+    NativeObject object = static_cast<NativeObject>(kind);
+    Nan::Set(objects, Nan::New(nativeObjectName(object)).ToLocalChecked(), Nan::New(static_cast<double>(liveObjects(object).load())));
+  }
+
+  DWORD handles = 0;
+  GetProcessHandleCount(GetCurrentProcess(), &handles);
+  HEAP_SUMMARY heap = {};
+  heap.cb = sizeof(heap);
+  double heapAllocated = HeapSummary(GetProcessHeap(), 0, &heap) ? static_cast<double>(heap.cbAllocated) : -1;
+
+  auto result = Nan::New<v8::Object>();
+  Nan::Set(result, Nan::New("objects").ToLocalChecked(), objects);
+  Nan::Set(result, Nan::New("handles").ToLocalChecked(), Nan::New(static_cast<double>(handles)));
+  Nan::Set(result, Nan::New("heapAllocated").ToLocalChecked(), Nan::New(heapAllocated));
+  info.GetReturnValue().Set(result);
+}
+
+// Acquisitions of the internal mutexes by the class owning them, counted since the module loaded:
+// { EventQueue: { acquired, contended, waitedMs }, ... }
+NAN_METHOD(GetLockStats)
+{
+  auto result = Nan::New<v8::Object>();
+  for (size_t site = 0; site < lockSites; site++)
+  {
+    LockCounters& counters = lockCounters(static_cast<LockSite>(site));
+    auto entry = Nan::New<v8::Object>();
+    Nan::Set(entry, Nan::New("acquired").ToLocalChecked(), Nan::New(static_cast<double>(counters.acquired.load())));
+    Nan::Set(entry, Nan::New("contended").ToLocalChecked(), Nan::New(static_cast<double>(counters.contended.load())));
+    Nan::Set(entry, Nan::New("waitedMs").ToLocalChecked(), Nan::New(counters.waitedMicros.load() / 1000.0));
+    Nan::Set(result, Nan::New(lockSiteName(static_cast<LockSite>(site))).ToLocalChecked(), entry);
+  }
+  info.GetReturnValue().Set(result);
+}
+
+// Returns every endpoint as one columnar object instead of an object per device:
+// { ids, names, descriptions, jackSubTypes, flows: Uint8Array, states: Uint32Array, formFactors: Uint32Array, handles: Uint32Array }
+NAN_METHOD(GetDevices)
+{
+  try
+  {
+    std::vector<DeviceMetadata> devices = DeviceMetadataCache::shared().snapshot();
+    size_t count = devices.size();
+
+    auto ids = Nan::New<v8::Array>(static_cast<int>(count));
+    auto names = Nan::New<v8::Array>(static_cast<int>(count));
+    auto descriptions = Nan::New<v8::Array>(static_cast<int>(count));
+    auto jackSubTypes = Nan::New<v8::Array>(static_cast<int>(count));
+    std::vector<uint8_t> flows(count);
+    std::vector<uint32_t> states(count);
+    std::vector<uint32_t> formFactors(count);
+    std::vector<uint32_t> handles(count);
+
+    // Every device string repeats across calls, so all four columns go through the interner
+    JsStringBatch strings(count * 4);
+    for (const DeviceMetadata& device : devices)
+    {
+      strings.add(device.id, InternPool::Devices);
+      strings.add(device.name, InternPool::Devices);
+      strings.add(device.description, InternPool::Devices);
+      strings.add(device.jackSubType, InternPool::Devices);
+    }
+    strings.build();
+    JsStringInterner::shared().sweep(InternPool::Devices);
+
+    for (size_t i = 0; i < count; i++)
+    {
+      const DeviceMetadata& device = devices[i];
+      Nan::Set(ids, static_cast<uint32_t>(i), strings[i * 4]);
+      Nan::Set(names, static_cast<uint32_t>(i), strings[i * 4 + 1]);
+      Nan::Set(descriptions, static_cast<uint32_t>(i), strings[i * 4 + 2]);
+      Nan::Set(jackSubTypes, static_cast<uint32_t>(i), strings[i * 4 + 3]);
+      flows[i] = static_cast<uint8_t>(device.flow);
+      states[i] = device.state;
+      formFactors[i] = device.formFactor;
+      handles[i] = device.handle;
+    }
+
+    auto result = Nan::New<v8::Object>();
+    Nan::Set(result, Nan::New("ids").ToLocalChecked(), ids);
+    Nan::Set(result, Nan::New("names").ToLocalChecked(), names);
+    Nan::Set(result, Nan::New("descriptions").ToLocalChecked(), descriptions);
+    Nan::Set(result, Nan::New("jackSubTypes").ToLocalChecked(), jackSubTypes);
+    Nan::Set(result, Nan::New("flows").ToLocalChecked(), toTypedArray<v8::Uint8Array>(flows.data(), count));
+    Nan::Set(result, Nan::New("states").ToLocalChecked(), toTypedArray<v8::Uint32Array>(states.data(), count));
+    Nan::Set(result, Nan::New("formFactors").ToLocalChecked(), toTypedArray<v8::Uint32Array>(formFactors.data(), count));
+    Nan::Set(result, Nan::New("handles").ToLocalChecked(), toTypedArray<v8::Uint32Array>(handles.data(), count));
+    info.GetReturnValue().Set(result);
+  }
+  catch (std::string e)
+  {
+    return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+  }
+}
+
+// setCapturePrivacy(on): mutes every microphone, and those plugged in later, or unmutes what it muted.
+// Returns the number of endpoints changed.
+NAN_METHOD(SetCapturePrivacy)
+{
+  if (info.Length() != 1 || !info[0]->IsBoolean())
+  {
+    return Nan::ThrowError(Nan::New("Exactly one boolean is required.").ToLocalChecked());
+  }
+  try
+  {
+    CapturePrivacy& privacy = CapturePrivacy::shared();
+    size_t changed = info[0]->IsTrue() ? privacy.engage() : privacy.disengage();
+    info.GetReturnValue().Set(Nan::New(static_cast<uint32_t>(changed)));
+  }
+  catch (std::string e)
+  {
+    return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+  }
+}
+
+NAN_METHOD(IsCapturePrivacyOn)
+{
+  try
+  {
+    info.GetReturnValue().Set(CapturePrivacy::shared().isEngaged());
+  }
+  catch (std::string e)
+  {
+    return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+  }
+}
+
+// getDefaultDevice({ flow?, role? }): the endpoint id of the current default, null when there is none
+NAN_METHOD(GetDefaultDevice)
+{
+  try
+  {
+    std::wstring id = defaultDeviceArgument(info[0]->IsObject() ? info[0].As<v8::Object>() : Nan::New<v8::Object>());
+    if (id.empty())
+    {
+      info.GetReturnValue().SetNull();
+      return;
+    }
+    JsStringBatch strings(1);
+    strings.add(id, InternPool::Devices);
+    strings.build();
+    info.GetReturnValue().Set(strings[0]);
+  }
+  catch (std::string e)
+  {
+    return Nan::ThrowError(Nan::New(e).ToLocalChecked());
+  }
+}
+
+void UnInitialize(void*)
+{
+  AUDIO_TRACE_UNREGISTER();
+  VolumeControlWrapper::clearPool();
+  JsStringInterner::shutdown();
+  CapturePrivacy::shutdown();
+  DefaultDeviceCache::shutdown();
+  DeviceMetadataCache::shutdown();
+  EndpointNotifier::shutdown();
+  CoUninitialize();
+}
+
+NAN_MODULE_INIT(InitModule)
+{
+  CoInitialize(NULL);
+  AUDIO_TRACE_REGISTER();
+
+  VolumeControlWrapper::Init(target);
+  MicrophoneMuteWrapper::Init(target);
+  SharedStateWrapper::Init(target);
+  Nan::SetMethod(target, "resolveProcessNames", ResolveProcessNames);
+  Nan::SetMethod(target, "getProcessNameCacheStats", GetProcessNameCacheStats);
+  Nan::SetMethod(target, "getControllerStats", GetControllerStats);
+  Nan::SetMethod(target, "getNativeStats", GetNativeStats);
+  Nan::SetMethod(target, "getLockStats", GetLockStats);
+  Nan::SetMethod(target, "getDevices", GetDevices);
+  Nan::SetMethod(target, "setCapturePrivacy", SetCapturePrivacy);
+  Nan::SetMethod(target, "getDefaultDevice", GetDefaultDevice);
+  Nan::SetMethod(target, "isCapturePrivacyOn", IsCapturePrivacyOn);
+
+  // Type names by the codes of packed events
+  auto eventTypes = Nan::New<v8::Array>();
+  for (uint32_t code = 0; code <= static_cast<uint32_t>(AudioEventType::LeaseChanged); code++)
+  {
+    Nan::Set(eventTypes, code, Nan::New(eventTypeName(static_cast<AudioEventType>(code))).ToLocalChecked());
+  }
+  Nan::Set(target, Nan::New("eventTypes").ToLocalChecked(), eventTypes);
 
   node::AddEnvironmentCleanupHook(Nan::GetCurrentContext()->GetIsolate(), UnInitialize, (void*)NULL);
 }
@@ -0,0 +1,247 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "lock_stats.h"
+
+// Volume and mute history of a device and its sessions, fed by change notifications. Each
+// series keeps three tiers in fixed memory: the latest raw changes, delta encoded, plus
+// per-second buckets for the last hour and per-minute buckets for the last day. When more than
+// `maxSeries` series are tracked, the one updated least recently is dropped.
+class VolumeHistory
+{
+public:
+  enum class Resolution
+  {
+    Raw,
+    Second,
+    Minute,
+  };
+
+  enum MuteFlags : uint8_t
+  {
+    MutedAtEnd = 1, // Muted after the sample or at the end of the bucket
+    MutedAtAll = 2, // Muted at some point during the bucket
+  };
+
+  // Packed columns of a range query. Raw samples have equal min, max and last.
+  struct Range
+  {
+    std::vector<double> times; // Unix time in ms of the sample or bucket start
+    std::vector<float> minimum;
+    std::vector<float> maximum;
+    std::vector<float> last;
+    std::vector<uint8_t> muted; // MuteFlags
+  };
+
+  static const size_t rawCapacity = 1024;
+  static const size_t secondBuckets = 3600;
+  static const size_t minuteBuckets = 1440;
+
+  explicit VolumeHistory(size_t maxSeries = 64) : maxSeries(maxSeries)
+  {
+  }
+
+  void record(uint32_t key, uint64_t timeMs, float volume, bool muted)
+  {
+    uint16_t level = quantize(volume);
+    std::lock_guard<CountedMutex> lock(mutex);
+    Series& series = seriesFor(key);
+    series.lastUpdate = timeMs;
+
+    // Raw tier: a ring of time deltas, the absolute time of the oldest sample is kept aside
+    if (series.rawCount == rawCapacity)
+    {
+      series.rawStart = (series.rawStart + 1) % rawCapacity;
+      series.rawCount--;
+      series.oldestTime += series.raw[series.rawStart].delta;
+    }
+    RawSample& sample = series.raw[(series.rawStart + series.rawCount) % rawCapacity];
+    uint64_t delta = series.rawCount == 0 ? 0 : timeMs - std::min(timeMs, series.newestTime);
+    sample.delta = static_cast<uint32_t>(std::min<uint64_t>(delta, UINT32_MAX));
+    sample.level = level;
+    sample.muted = muted ? 1 : 0;
+    if (series.rawCount == 0)
+    {
+      series.oldestTime = timeMs;
+    }
+    series.newestTime = series.rawCount == 0 ? timeMs : std::max(series.newestTime, timeMs);
+    series.rawCount++;
+
+    recordBucket(series.seconds, secondBuckets, timeMs / 1000, level, muted);
+    recordBucket(series.minutes, minuteBuckets, timeMs / 60000, level, muted);
+  }
+
+  // Samples or buckets with changes in [fromMs, toMs]. Buckets without changes are left out,
+  // the volume holds its previous value through them.
+  Range query(uint32_t key, uint64_t fromMs, uint64_t toMs, Resolution resolution) const
+  {
+    Range range;
+    std::lock_guard<CountedMutex> lock(mutex);
+    const Series* series = find(key);
+    if (!series)
+    {
+      return range;
+    }
+    toMs = std::min(toMs, series->newestTime); // Nothing recorded past the newest sample
+    if (fromMs > toMs)
+    {
+      return range;
+    }
+
+    switch (resolution)
+    {
+      case Resolution::Raw:
+      {
+        uint64_t time = series->oldestTime;
+        for (size_t i = 0; i < series->rawCount; i++)
+        {
+          const RawSample& sample = series->raw[(series->rawStart + i) % rawCapacity];
+          time += i == 0 ? 0 : sample.delta;
+          if (time > toMs)
+          {
+            break;
+          }
+          if (time >= fromMs)
+          {
+            float value = dequantize(sample.level);
+            uint8_t muted = sample.muted ? MutedAtEnd | MutedAtAll : 0;
+            append(range, static_cast<double>(time), value, value, value, muted);
+          }
+        }
+        break;
+      }
+      case Resolution::Second:
+        queryBuckets(series->seconds, secondBuckets, 1000, fromMs, toMs, range);
+        break;
+      case Resolution::Minute:
+        queryBuckets(series->minutes, minuteBuckets, 60000, fromMs, toMs, range);
+        break;
+    }
+    return range;
+  }
+
+private:
+  struct RawSample
+  {
+    uint32_t delta; // ms since the previous sample
+    uint16_t level; // Volume scaled to 0..65535
+    uint8_t muted;
+  };
+
+  struct Bucket
+  {
+    uint64_t epoch; // Bucket number since the Unix epoch, tells whether the slot is current
+    uint16_t minimum;
+    uint16_t maximum;
+    uint16_t last;
+    uint8_t muted; // MuteFlags
+    bool used;
+  };
+
+  struct Series
+  {
+    uint32_t key;
+    uint64_t lastUpdate = 0;
+    uint64_t oldestTime = 0;
+    uint64_t newestTime = 0;
+    size_t rawStart = 0;
+    size_t rawCount = 0;
+    std::vector<RawSample> raw = std::vector<RawSample>(rawCapacity);
+    std::vector<Bucket> seconds = std::vector<Bucket>(secondBuckets);
+    std::vector<Bucket> minutes = std::vector<Bucket>(minuteBuckets);
+  };
+
+  size_t maxSeries;
+  mutable CountedMutex mutex{LockSite::VolumeHistory};
+  std::vector<std::unique_ptr<Series>> series;
+
+  static uint16_t quantize(float volume)
+  {
+    return static_cast<uint16_t>(std::lround(std::min(1.0f, std::max(0.0f, volume)) * 65535.0f));
+  }
+
+  static float dequantize(uint16_t level)
+  {
+    return level / 65535.0f;
+  }
+
+  const Series* find(uint32_t key) const
+  {
+    for (const auto& candidate : series)
+    {
+      if (candidate->key == key)
+      {
+        return candidate.get();
+      }
+    }
+    return nullptr;
+  }
+
+  Series& seriesFor(uint32_t key)
+  {
+    auto found = std::find_if(series.begin(), series.end(), [&](const std::unique_ptr<Series>& candidate) { return candidate->key == key; });
+    if (found != series.end())
+    {
+      return **found;
+    }
+
+    if (series.size() >= maxSeries)
+    {
+      auto stalest = std::min_element(series.begin(), series.end(), [](const std::unique_ptr<Series>& a, const std::unique_ptr<Series>& b) {
+        return a->lastUpdate < b->lastUpdate;
+      });
+      series.erase(stalest);
+    }
+
+    series.emplace_back(new Series());
+    series.back()->key = key;
+    return *series.back();
+  }
+
+  static void recordBucket(std::vector<Bucket>& buckets, size_t count, uint64_t epoch, uint16_t level, bool muted)
+  {
+    Bucket& bucket = buckets[epoch % count];
+    if (!bucket.used || bucket.epoch != epoch)
+    {
+      bucket = Bucket{epoch, level, level, level, 0, true};
+    }
+    bucket.minimum = std::min(bucket.minimum, level);
+    bucket.maximum = std::max(bucket.maximum, level);
+    bucket.last = level;
+    bucket.muted = static_cast<uint8_t>((bucket.muted & MutedAtAll) | (muted ? MutedAtEnd | MutedAtAll : 0));
+  }
+
+  static void queryBuckets(const std::vector<Bucket>& buckets, size_t count, uint64_t widthMs, uint64_t fromMs, uint64_t toMs, Range& range)
+  {
+    uint64_t first = fromMs / widthMs;
+    uint64_t last = toMs / widthMs;
+    // Older buckets have been overwritten by the ring, no need to look at them
+    if (last - first >= count)
+    {
+      first = last - count + 1;
+    }
+
+    for (uint64_t epoch = first; epoch <= last; epoch++)
+    {
+      const Bucket& bucket = buckets[epoch % count];
+      if (bucket.used && bucket.epoch == epoch)
+      {
+        append(range, static_cast<double>(epoch * widthMs), dequantize(bucket.minimum), dequantize(bucket.maximum), dequantize(bucket.last), bucket.muted);
+      }
+    }
+  }
+
+  static void append(Range& range, double time, float minimum, float maximum, float last, uint8_t muted)
+  {
+    range.times.push_back(time);
+    range.minimum.push_back(minimum);
+    range.maximum.push_back(maximum);
+    range.last.push_back(last);
+    range.muted.push_back(muted);
+  }
+};
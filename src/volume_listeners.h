@@ -0,0 +1,150 @@
+#pragma once
+#include <windows.h>
+#include <audiopolicy.h>
+#include <endpointvolume.h>
+#include <functional>
+#include "object_counts.h"
+#include "tracepoints.h"
+
+// IAudioEndpointVolumeCallback forwarding every endpoint volume change to a handler. The handler
+// runs on a COM worker thread.
+class EndpointVolumeListener : public IAudioEndpointVolumeCallback
+{
+public:
+  typedef std::function<void(const AUDIO_VOLUME_NOTIFICATION_DATA&)> Handler;
+
+  explicit EndpointVolumeListener(Handler handler) : handler(std::move(handler))
+  {
+  }
+
+  ULONG STDMETHODCALLTYPE AddRef() override
+  {
+    return InterlockedIncrement(&references);
+  }
+
+  ULONG STDMETHODCALLTYPE Release() override
+  {
+    ULONG remaining = InterlockedDecrement(&references);
+    if (remaining == 0)
+    {
+      delete this;
+    }
+    return remaining;
+  }
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override
+  {
+    if (riid == __uuidof(IUnknown) || riid == __uuidof(IAudioEndpointVolumeCallback))
+    {
+      *object = static_cast<IAudioEndpointVolumeCallback*>(this);
+      AddRef();
+      return S_OK;
+    }
+    *object = NULL;
+    return E_NOINTERFACE;
+  }
+
+  HRESULT STDMETHODCALLTYPE OnNotify(PAUDIO_VOLUME_NOTIFICATION_DATA data) override
+  {
+    AUDIO_TRACE_NOTIFICATION("endpointVolume");
+    handler(*data);
+    return S_OK;
+  }
+
+private:
+  LONG references = 1;
+  Handler handler;
+  ObjectCount<NativeObject::EndpointVolumeListener> counted;
+};
+
+// IAudioSessionEvents forwarding the volume and state changes of one session. The handlers run
+// on a COM worker thread.
+class SessionEventsListener : public IAudioSessionEvents
+{
+public:
+  typedef std::function<void(float volume, BOOL muted, LPCGUID context)> VolumeHandler;
+  typedef std::function<void(AudioSessionState state)> StateHandler;
+
+  SessionEventsListener(VolumeHandler onVolume, StateHandler onState)
+    : onVolume(std::move(onVolume)), onState(std::move(onState))
+  {
+  }
+
+  ULONG STDMETHODCALLTYPE AddRef() override
+  {
+    return InterlockedIncrement(&references);
+  }
+
+  ULONG STDMETHODCALLTYPE Release() override
+  {
+    ULONG remaining = InterlockedDecrement(&references);
+    if (remaining == 0)
+    {
+      delete this;
+    }
+    return remaining;
+  }
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override
+  {
+    if (riid == __uuidof(IUnknown) || riid == __uuidof(IAudioSessionEvents))
+    {
+      *object = static_cast<IAudioSessionEvents*>(this);
+      AddRef();
+      return S_OK;
+    }
+    *object = NULL;
+    return E_NOINTERFACE;
+  }
+
+  HRESULT STDMETHODCALLTYPE OnSimpleVolumeChanged(float volume, BOOL muted, LPCGUID context) override
+  {
+    AUDIO_TRACE_NOTIFICATION("sessionVolume");
+    if (onVolume)
+    {
+      onVolume(volume, muted, context);
+    }
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE OnStateChanged(AudioSessionState state) override
+  {
+    AUDIO_TRACE_NOTIFICATION("sessionState");
+    if (onState)
+    {
+      onState(state);
+    }
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE OnDisplayNameChanged(LPCWSTR, LPCGUID) override
+  {
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE OnIconPathChanged(LPCWSTR, LPCGUID) override
+  {
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE OnChannelVolumeChanged(DWORD, float[], DWORD, LPCGUID) override
+  {
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE OnGroupingParamChanged(LPCGUID, LPCGUID) override
+  {
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE OnSessionDisconnected(AudioSessionDisconnectReason) override
+  {
+    return S_OK;
+  }
+
+private:
+  LONG references = 1;
+  VolumeHandler onVolume;
+  StateHandler onState;
+  ObjectCount<NativeObject::SessionEventsListener> counted;
+};